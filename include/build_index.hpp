@@ -0,0 +1,5 @@
+#pragma once
+
+#include "options.hpp"
+
+void build_index(smash_options const & options);
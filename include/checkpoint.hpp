@@ -0,0 +1,413 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include <robin_hood.h>
+
+/* A drop-in for raptor::sync_out that can periodically record which queries are completely written.
+ *
+ * Rows are not written by the calling thread: they are pushed to a lock-free multi-producer queue and a writer thread
+ * collects them into large writes. With `ordered`, rows written with an index are written in the order of their
+ * indices, using a reorder buffer of `reorder_capacity` rows; a thread whose row is that far ahead of the next row
+ * to write waits. Every index from 0 on must be written exactly once. Rows without an index are written as they come.
+ *
+ * Every `interval` the output is flushed and fsynced, then the names of all queries written since the last
+ * checkpoint are appended to `<output>.checkpoint`, followed by a commit line `@<bytes of output>`, and that file
+ * is fsynced as well. Only names before the last commit line count as completed, so a crash in the middle of a
+ * checkpoint loses at most one interval of work.
+ *
+ * When resuming, the output is truncated to the last committed size (dropping partial rows) and opened for appending.
+ * Resuming without a checkpoint file fails if the output exists, the output may be complete and is not overwritten.
+ * An interval of 0 disables checkpointing. Every run that does not resume starts a new checkpoint file or, without
+ * checkpointing, removes an existing one.
+ *
+ * close() must be called after the last row; it rethrows the first write error. A thread that fails before writing
+ * its row must call abort(), otherwise threads waiting for that row in an ordered output would wait forever; after
+ * abort(), every write() throws.
+ */
+class checkpointed_out
+{
+public:
+    checkpointed_out(std::filesystem::path const & output_file,
+                     std::chrono::seconds const interval,
+                     bool const resume,
+                     bool const ordered = false,
+                     size_t const reorder_capacity = 1024) :
+        output_name{output_file.string()},
+        checkpoint_file{output_file.string() + ".checkpoint"},
+        interval{interval},
+        ordered{ordered},
+        reorder_buffer(ordered ? std::max<size_t>(reorder_capacity, 1) : 0)
+    {
+        uint64_t committed_size{0};
+
+        if (resume && std::filesystem::exists(checkpoint_file))
+            committed_size = read_checkpoint();
+        else if (resume && std::filesystem::exists(output_file) && std::filesystem::file_size(output_file) > 0)
+            throw std::runtime_error{"Cannot resume " + output_name + ": there is no checkpoint file " +
+                                     checkpoint_file + ". Please run without --resume to overwrite the output."};
+
+        if (committed_size > 0 && std::filesystem::exists(output_file))
+        {
+            std::filesystem::resize_file(output_file, committed_size);
+            out = std::fopen(output_file.c_str(), "ab");
+            resumed = true;
+        }
+        else
+        {
+            out = std::fopen(output_file.c_str(), "wb");
+            completed.clear();
+            // start a new checkpoint file; without checkpointing, one of an earlier run must not survive, a later
+            // --resume would take its queries as completed
+            if (this->interval.count() > 0)
+                std::ofstream{checkpoint_file, std::ios::trunc};
+            else
+                std::filesystem::remove(checkpoint_file);
+        }
+
+        if (out == nullptr)
+            throw std::runtime_error{"Could not open file " + output_file.string()};
+
+        last_checkpoint = std::chrono::steady_clock::now();
+
+        // the initial tail is a dummy node, owned by the queue once the writer runs
+        std::unique_ptr<node> dummy = std::make_unique<node>();
+        tail = dummy.get();
+        head.store(tail, std::memory_order_relaxed);
+        writer = std::thread{[this] () { write_loop(); }};
+        dummy.release();
+    }
+
+    checkpointed_out(checkpointed_out const &) = delete;
+    checkpointed_out & operator=(checkpointed_out const &) = delete;
+
+    // only reached without close() if the search failed, the error of the search is more interesting
+    ~checkpointed_out()
+    {
+        try
+        {
+            close();
+        }
+        catch (std::exception const & e)
+        {
+            std::cerr << "[ERROR] " << e.what() << '\n';
+        }
+
+        delete tail;
+    }
+
+    // writes all rows and closes the output, throws if any of that failed
+    void close()
+    {
+        if (out == nullptr)
+            return;
+
+        stopping.store(true, std::memory_order_release);
+        pushed.fetch_add(1, std::memory_order_release);
+        pushed.notify_one();
+        writer.join();
+
+        while (pop()) // rows that were not written because of an error
+            ;
+
+        bool const closed = (std::fclose(out) == 0);
+        out = nullptr;
+
+        if (error)
+            std::rethrow_exception(error);
+        if (!closed)
+            throw std::runtime_error{"Could not write to " + output_name};
+    }
+
+    // releases threads waiting for a row that will never be written, see above
+    void abort()
+    {
+        std::lock_guard<std::mutex> lock{next_index_mutex};
+        aborted.store(true, std::memory_order_release);
+        next_index.store(std::numeric_limits<size_t>::max() / 2, std::memory_order_release);
+        next_index.notify_all();
+    }
+
+    // true if the output already contains a header and some rows from a previous run
+    bool is_resumed() const
+    {
+        return resumed;
+    }
+
+    // the queries that were completed in a previous run
+    robin_hood::unordered_set<std::string> const & completed_queries() const
+    {
+        return completed;
+    }
+
+    // rows that were written but are still in the queue or the reorder buffer
+    uint64_t queued_rows() const
+    {
+        uint64_t const out = rows_emitted.load(std::memory_order_relaxed);
+        uint64_t const in = rows_pushed.load(std::memory_order_relaxed);
+        return (in > out) ? in - out : 0;
+    }
+
+    void write(std::string const & data)
+    {
+        push(data, std::string{}, no_index);
+    }
+
+    // writes the result row of `query` and marks `query` as done once the row reached the disk
+    void write(std::string const & data, std::string const & query)
+    {
+        push(data, query, no_index);
+    }
+
+    // as above, with `ordered` the row is written after the rows with the indices 0 ... index - 1
+    void write(std::string const & data, std::string const & query, size_t const index)
+    {
+        if (!ordered)
+            return push(data, query, no_index);
+
+        // bounded reorder buffer: wait until the row fits
+        for (size_t next = next_index.load(std::memory_order_acquire);
+             index >= next + reorder_buffer.size() && !failed.load(std::memory_order_acquire) &&
+             !aborted.load(std::memory_order_acquire);
+             next = next_index.load(std::memory_order_acquire))
+        {
+            next_index.wait(next, std::memory_order_acquire);
+        }
+
+        push(data, query, index);
+    }
+
+private:
+    static constexpr size_t no_index{std::numeric_limits<size_t>::max()};
+    static constexpr size_t batch_size{1ULL << 22};
+
+    struct row
+    {
+        std::string data{};
+        std::string query{};
+        size_t index{no_index};
+    };
+
+    // node of an intrusive multi-producer single-consumer queue (Vyukov): producers exchange the head,
+    // the writer thread follows the `next` pointers from the tail, which is always a consumed node
+    struct node
+    {
+        std::atomic<node *> next{nullptr};
+        row value{};
+    };
+
+    void push(std::string const & data, std::string const & query, size_t const index)
+    {
+        if (failed.load(std::memory_order_acquire))
+            std::rethrow_exception(error);
+        if (aborted.load(std::memory_order_acquire))
+            throw std::runtime_error{"Writing " + output_name + " was aborted."};
+
+        node * const new_node = new node{};
+        new_node->value = row{data, query, index};
+
+        node * const previous = head.exchange(new_node, std::memory_order_acq_rel);
+        previous->next.store(new_node, std::memory_order_release);
+
+        rows_pushed.fetch_add(1, std::memory_order_relaxed);
+        pushed.fetch_add(1, std::memory_order_release);
+        pushed.notify_one();
+    }
+
+    std::optional<row> pop()
+    {
+        node * const next = tail->next.load(std::memory_order_acquire);
+        if (next == nullptr)
+            return std::nullopt;
+
+        delete tail;
+        tail = next;
+        return std::move(next->value);
+    }
+
+    void write_loop()
+    {
+        try
+        {
+            while (true)
+            {
+                uint64_t const seen = pushed.load(std::memory_order_acquire);
+                bool const stop = stopping.load(std::memory_order_acquire);
+
+                for (std::optional<row> value = pop(); value; value = pop())
+                {
+                    if (value->index == no_index)
+                        emit(*value);
+                    else
+                        reorder(std::move(*value));
+                }
+
+                if (stop)
+                    break;
+
+                // nothing to do: write what we have, then sleep until the next row arrives
+                flush_batch();
+                pushed.wait(seen, std::memory_order_acquire);
+            }
+
+            flush_batch();
+            if (interval.count() > 0)
+                checkpoint();
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+            failed.store(true, std::memory_order_release);
+
+            // release waiting producers, they throw the error
+            std::lock_guard<std::mutex> lock{next_index_mutex};
+            next_index.store(std::numeric_limits<size_t>::max() / 2, std::memory_order_release);
+            next_index.notify_all();
+        }
+    }
+
+    void reorder(row && value)
+    {
+        reorder_buffer[value.index % reorder_buffer.size()] = std::move(value);
+
+        while (reorder_buffer[next_to_write % reorder_buffer.size()])
+        {
+            std::optional<row> & slot = reorder_buffer[next_to_write % reorder_buffer.size()];
+            emit(*slot);
+            slot.reset();
+            ++next_to_write;
+        }
+
+        // abort() released the waiting producers for good, that must not be undone
+        std::lock_guard<std::mutex> lock{next_index_mutex};
+        if (aborted.load(std::memory_order_acquire))
+            return;
+        next_index.store(next_to_write, std::memory_order_release);
+        next_index.notify_all();
+    }
+
+    void emit(row const & value)
+    {
+        batch += value.data;
+        rows_emitted.store(rows_emitted.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+        if (batch.size() >= batch_size)
+            flush_batch();
+
+        if (interval.count() > 0 && !value.query.empty())
+        {
+            pending.push_back(value.query);
+
+            if (std::chrono::steady_clock::now() - last_checkpoint >= interval)
+                checkpoint();
+        }
+    }
+
+    void flush_batch()
+    {
+        if (std::fwrite(batch.data(), 1, batch.size(), out) != batch.size())
+            throw std::runtime_error{"Could not write to " + output_name};
+        batch.clear();
+    }
+
+    uint64_t read_checkpoint()
+    {
+        std::ifstream fin{checkpoint_file};
+        std::string line;
+        std::vector<std::string> uncommitted{};
+        uint64_t committed_size{0};
+
+        while (std::getline(fin, line))
+        {
+            if (!line.empty() && line[0] == '@')
+            {
+                committed_size = std::stoull(line.substr(1));
+                for (auto & name : uncommitted)
+                    completed.insert(std::move(name));
+                uncommitted.clear();
+            }
+            else if (!line.empty())
+            {
+                uncommitted.push_back(line);
+            }
+        }
+
+        return committed_size;
+    }
+
+    void checkpoint()
+    {
+        flush_batch();
+        if (std::fflush(out) != 0 || fsync(fileno(out)) != 0)
+            throw std::runtime_error{"Could not write to " + output_name};
+
+        std::FILE * checkpoint_out = std::fopen(checkpoint_file.c_str(), "ab");
+        if (checkpoint_out == nullptr)
+            throw std::runtime_error{"Could not open file " + checkpoint_file};
+
+        std::string lines{};
+        for (auto const & name : pending)
+        {
+            lines += name;
+            lines += '\n';
+        }
+        lines += '@';
+        lines += std::to_string(static_cast<uint64_t>(std::ftell(out)));
+        lines += '\n';
+
+        bool const written = std::fwrite(lines.data(), 1, lines.size(), checkpoint_out) == lines.size() &&
+                             std::fflush(checkpoint_out) == 0 &&
+                             fsync(fileno(checkpoint_out)) == 0;
+        if (std::fclose(checkpoint_out) != 0 || !written)
+            throw std::runtime_error{"Could not write to " + checkpoint_file};
+
+        pending.clear();
+        last_checkpoint = std::chrono::steady_clock::now();
+    }
+
+    std::string output_name{};
+    std::string checkpoint_file{};
+    std::chrono::seconds interval{};
+    std::chrono::steady_clock::time_point last_checkpoint{};
+    std::FILE * out{nullptr};
+    bool resumed{false};
+    bool ordered{false};
+
+    // queue, the initial tail is a dummy node (allocated at the end of the constructor)
+    node * tail{nullptr};
+    std::atomic<node *> head{nullptr};
+    std::atomic<uint64_t> pushed{0};
+    std::atomic<uint64_t> rows_pushed{0};
+    std::atomic<uint64_t> rows_emitted{0}; // only written by the writer thread
+    std::atomic<bool> stopping{false};
+    std::atomic<bool> failed{false};
+    std::atomic<bool> aborted{false};
+    std::exception_ptr error{}; // set by the writer thread before `failed`
+
+    // only used by the writer thread (next_index is read by waiting producers, set under the mutex)
+    std::string batch{};
+    std::vector<std::optional<row>> reorder_buffer{};
+    size_t next_to_write{0};
+    std::atomic<size_t> next_index{0};
+    std::mutex next_index_mutex{};
+    std::vector<std::string> pending{};
+
+    robin_hood::unordered_set<std::string> completed{};
+    std::thread writer{};
+};
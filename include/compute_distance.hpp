@@ -3,7 +3,8 @@
 // computes the Jaqquard Index Value (sorry for the name)
 // A = what I sketch/search from
 // B = whats stored in my Bloom filter
-double compute_distance(uint64_t const count,
+// sketch_size is the number of hashes that were counted, i.e. the number of distinct hashes in a scaled sketch
+inline double compute_distance(uint64_t const count,
                         uint64_t const sketch_size,
                         double const fpr,
                         uint64_t const size_of_A,
@@ -11,6 +12,9 @@ double compute_distance(uint64_t const count,
 {
     // Todo: is the -fpr always correct? isn't the impact stronger when JI is low ?
 
+    if (sketch_size == 0) // e.g. a scaled sketch of a tiny genome
+        return 0.0;
+
     // Containement estimate
     // Paper: C_est = ( Y^k / k ) − p
     // Here : C_est = ( count / sketch_size ) − fpr
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+/* Count-min sketch with 8 bit saturating counters and conservative update, for counting k-mer hashes in fixed memory.
+ * The estimate of a hash is never below its true count. With conservative update, adding a hash raises its estimate
+ * by exactly one (unless saturated), which lets a caller react once when a hash reaches an abundance.
+ */
+class count_min_sketch
+{
+public:
+    static constexpr size_t depth{4};
+
+    // resizes to at most `memory` bytes (the width is rounded down to a power of two) and sets all counts to zero
+    void reset(size_t const memory)
+    {
+        size_t const width = std::bit_floor(std::max<size_t>(memory / depth, 64));
+
+        if (width != row_width)
+        {
+            row_width = width;
+            row_shift = 64 - std::countr_zero(width);
+            counters.assign(depth * width, 0);
+        }
+        else
+        {
+            std::ranges::fill(counters, 0);
+        }
+    }
+
+    // counts `hash` once more and returns its new estimated count
+    uint8_t add(uint64_t const hash)
+    {
+        std::array<size_t, depth> positions;
+        uint8_t minimum{std::numeric_limits<uint8_t>::max()};
+
+        for (size_t row = 0; row < depth; ++row)
+        {
+            positions[row] = row * row_width + ((hash * multipliers[row]) >> row_shift); // multiplicative hashing
+            minimum = std::min(minimum, counters[positions[row]]);
+        }
+
+        if (minimum == std::numeric_limits<uint8_t>::max())
+            return minimum;
+
+        for (size_t const position : positions)
+            if (counters[position] == minimum)
+                ++counters[position];
+
+        return minimum + 1;
+    }
+
+private:
+    static constexpr std::array<uint64_t, depth> multipliers{0x9E3779B97F4A7C15ULL,
+                                                             0xC2B2AE3D27D4EB4FULL,
+                                                             0x165667B19E3779F9ULL,
+                                                             0xD6E8FEB86659FD93ULL};
+
+    size_t row_width{0};
+    int row_shift{64};
+    std::vector<uint8_t> counters{};
+};
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+#include "options.hpp"
+
+// Jaccard estimate of two sorted sketches without duplicates, bottom-k or scaled (sketch_size == 0).
+double sketch_jaccard(std::span<uint64_t const> a, std::span<uint64_t const> b, uint64_t const sketch_size);
+
+void direct_search(smash_options const & options);
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <robin_hood.h>
+
+#include "options.hpp"
+
+// What `smash index` records about an index in <index>.smash:
+//   #kmer_size <tab> k
+//   #scale <tab> scale of the sketches that were indexed, 0 if all hashes were indexed
+//   #fpr <tab> fpr
+//   one line <user bin path> <tab> <reference> <tab> <number of k-mers of the reference> per user bin
+// The user bin paths are the files the index was built from, i.e. `index.bin_path()`.
+struct index_info
+{
+    uint8_t kmer_size{};
+    uint64_t scale{};
+    double fpr{};
+    std::vector<std::string> bin_paths{};
+    std::vector<std::string> references{};
+    std::vector<uint64_t> sizes{};
+};
+
+inline std::filesystem::path index_info_file(std::filesystem::path const & index_file)
+{
+    return index_file.string() + ".smash";
+}
+
+// nothing if the index was not built by `smash index`
+inline std::optional<index_info> read_index_info(std::filesystem::path const & index_file)
+{
+    std::filesystem::path const filename = index_info_file(index_file);
+    if (!std::filesystem::exists(filename))
+        return std::nullopt;
+
+    std::ifstream fin{filename};
+    if (!fin.good())
+        throw std::runtime_error{"Could not open file " + filename.string()};
+
+    index_info info{};
+    std::string line;
+    while (std::getline(fin, line))
+    {
+        if (line.empty())
+            continue;
+
+        size_t const tab = line.find('\t');
+        size_t const second_tab = line.find('\t', tab + 1);
+        if (tab == std::string::npos)
+            throw std::runtime_error{"Malformed line in " + filename.string() + ": " + line};
+
+        std::string const key = line.substr(0, tab);
+        std::string const value = line.substr(tab + 1);
+
+        if (key == "#kmer_size")
+            info.kmer_size = static_cast<uint8_t>(std::stoul(value));
+        else if (key == "#scale")
+            info.scale = std::stoull(value);
+        else if (key == "#fpr")
+            info.fpr = std::stod(value);
+        else if (key[0] == '#')
+            continue;
+        else if (second_tab == std::string::npos)
+            throw std::runtime_error{"Malformed line in " + filename.string() + ": " + line};
+        else
+        {
+            info.bin_paths.push_back(key);
+            info.references.push_back(line.substr(tab + 1, second_tab - tab - 1));
+            info.sizes.push_back(std::stoull(line.substr(second_tab + 1)));
+        }
+    }
+
+    return info;
+}
+
+inline void write_index_info(std::filesystem::path const & index_file, index_info const & info)
+{
+    std::filesystem::path const filename = index_info_file(index_file);
+    std::ofstream fout{filename};
+    if (!fout.good())
+        throw std::runtime_error{"Could not open file " + filename.string()};
+
+    fout << "#kmer_size\t" << +info.kmer_size << '\n'
+         << "#scale\t" << info.scale << '\n'
+         << "#fpr\t" << info.fpr << '\n';
+
+    for (size_t i = 0; i < info.bin_paths.size(); ++i)
+        fout << info.bin_paths[i] << '\t' << info.references[i] << '\t' << info.sizes[i] << '\n';
+
+    if (!fout)
+        throw std::runtime_error{"Could not write " + filename.string()};
+}
+
+// The reference of every user bin of an index, given its `index.bin_path()`, for the header of the matrix and for
+// clustering. A --scaled index is built from hash files in <index>_hashes, whose names mean nothing to the user and
+// differ from the query names. Without `info`, i.e. for an index built by raptor, the bin paths are the references.
+template <typename bin_paths_t>
+std::vector<std::string> bin_references(bin_paths_t const & bin_paths, std::optional<index_info> const & info)
+{
+    std::vector<std::string> references{};
+    for (auto const & filenames : bin_paths)
+    {
+        if (filenames.size() != 1)
+            throw std::runtime_error{"Multi file user bins not supported yet."};
+        references.push_back(filenames[0]);
+    }
+
+    if (!info)
+        return references;
+
+    robin_hood::unordered_map<std::string, size_t> position{};
+    for (size_t i = 0; i < info->bin_paths.size(); ++i)
+        position.emplace(info->bin_paths[i], i);
+
+    for (auto & reference : references)
+    {
+        auto const it = position.find(reference);
+        if (it == position.end())
+            throw std::runtime_error{"The user bin " + reference + " is not recorded in the index information."};
+        reference = info->references[it->second];
+    }
+
+    return references;
+}
+
+// Throws if the queries of `options`, hashed with `kmer_size`, cannot be searched in the index.
+// An index of scaled sketches only holds the hashes below its threshold, so the queries need a threshold at most as
+// large, i.e. a --scaled at least as large.
+inline void check_index_info(index_info const & info,
+                             std::filesystem::path const & index_file,
+                             uint8_t const kmer_size,
+                             smash_options const & options)
+{
+    if (info.kmer_size != kmer_size)
+        throw std::runtime_error{"The index " + index_file.string() + " was built with k = " +
+                                 std::to_string(info.kmer_size) + ", not " + std::to_string(kmer_size) + "."};
+
+    if (info.scale > 0 && options.scale < info.scale)
+        throw std::runtime_error{"The index " + index_file.string() + " only holds the hashes of --scaled " +
+                                 std::to_string(info.scale) + " sketches. Please search it with a --scaled of at "
+                                 "least " + std::to_string(info.scale) + "."};
+}
@@ -0,0 +1,281 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <ranges>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// A dense distance matrix as written by smash.
+// rows = query files, columns = user bins of the index, values are stored row-major.
+struct distance_matrix
+{
+    std::vector<std::string> column_names{};
+    std::vector<std::string> row_names{};
+    std::vector<double> values{};
+
+    size_t rows() const { return row_names.size(); }
+    size_t columns() const { return column_names.size(); }
+
+    double & at(size_t const row, size_t const column) { return values[row * columns() + column]; }
+    double at(size_t const row, size_t const column) const { return values[row * columns() + column]; }
+};
+
+// The binary format starts with this magic string followed by a version number.
+// Layout (little endian, host byte order):
+//   char[8] magic | uint32_t version | uint64_t #rows | uint64_t #columns |
+//   column names | row names | #rows * #columns doubles (row-major)
+// Every name is stored as uint64_t length followed by the characters.
+inline constexpr char binary_matrix_magic[8] = {'S', 'M', 'A', 'S', 'H', 'M', 'A', 'T'};
+inline constexpr uint32_t binary_matrix_version{1};
+
+inline std::string read_field(std::ranges::range auto && field)
+{
+    std::string result{};
+    std::ranges::copy(field, std::back_inserter(result));
+    return result;
+}
+
+// Reads a text matrix one row at a time without keeping it: on_columns(column names) once, then
+// on_row(row name, values) for every row, with one value per column.
+template <typename columns_fn_t, typename row_fn_t>
+void read_text_matrix_rows(std::istream & fin, columns_fn_t && on_columns, row_fn_t && on_row)
+{
+    std::vector<std::string> column_names{};
+    std::string line;
+
+    // read header line for column names
+    if (!std::getline(fin, line) || line.empty())
+        throw std::runtime_error{"The matrix has no header line."};
+    {
+        auto splitted_line = line | std::views::split('\t');
+        auto it = splitted_line.begin();
+        ++it; // skip `#filenames` in the beginning
+
+        while (it != splitted_line.end())
+        {
+            std::string name = read_field(*it);
+            if (!name.empty() && name.back() == ';')
+                name.pop_back();
+            column_names.push_back(name);
+            ++it;
+        }
+    }
+
+    on_columns(column_names);
+
+    std::vector<double> values{};
+    while (std::getline(fin, line))
+    {
+        if (line.empty())
+            continue;
+
+        auto splitted_line = line | std::views::split('\t');
+        auto it = splitted_line.begin();
+
+        std::string const row_name = read_field(*it);
+        ++it;
+
+        values.clear();
+        std::string number{};
+        while (it != splitted_line.end())
+        {
+            number = read_field(*it);
+            double tmp{};
+            auto const [end, ec] = std::from_chars(number.data(), number.data() + number.size(), tmp);
+            if (ec != std::errc{} || end != number.data() + number.size())
+                throw std::runtime_error{"Row " + row_name + " has the value \"" + number + "\", which is not a number."};
+            values.push_back(tmp);
+            ++it;
+        }
+
+        if (values.size() != column_names.size())
+            throw std::runtime_error{"Row " + row_name + " has " + std::to_string(values.size()) +
+                                     " columns but the header has " + std::to_string(column_names.size())};
+
+        on_row(row_name, values);
+    }
+}
+
+inline distance_matrix read_text_matrix(std::istream & fin)
+{
+    distance_matrix matrix{};
+    read_text_matrix_rows(fin,
+                          [&] (std::vector<std::string> const & names) { matrix.column_names = names; },
+                          [&] (std::string const & name, std::vector<double> const & values)
+                          {
+                              matrix.row_names.push_back(name);
+                              matrix.values.insert(matrix.values.end(), values.begin(), values.end());
+                          });
+    return matrix;
+}
+
+inline void write_text_matrix(distance_matrix const & matrix, std::ostream & fout)
+{
+    std::string line{"#filenames"};
+    for (auto const & name : matrix.column_names)
+    {
+        line += '\t';
+        line += name;
+        line += ';';
+    }
+    line += '\n';
+    fout << line;
+
+    for (size_t row = 0; row < matrix.rows(); ++row)
+    {
+        line = matrix.row_names[row];
+        for (size_t column = 0; column < matrix.columns(); ++column)
+        {
+            line += '\t';
+            line += std::to_string(matrix.at(row, column));
+        }
+        line += '\n';
+        fout << line;
+    }
+}
+
+// Like read_text_matrix_rows() for the binary format.
+template <typename columns_fn_t, typename row_fn_t>
+void read_binary_matrix_rows(std::istream & fin, columns_fn_t && on_columns, row_fn_t && on_row)
+{
+    char magic[sizeof(binary_matrix_magic)];
+    uint32_t version{};
+    fin.read(magic, sizeof(magic));
+    fin.read(reinterpret_cast<char *>(&version), sizeof(version));
+
+    if (!fin || std::memcmp(magic, binary_matrix_magic, sizeof(magic)) != 0)
+        throw std::runtime_error{"Not a smash binary matrix."};
+    if (version != binary_matrix_version)
+        throw std::runtime_error{"Unsupported binary matrix version " + std::to_string(version)};
+
+    uint64_t number_of_rows{};
+    uint64_t number_of_columns{};
+    fin.read(reinterpret_cast<char *>(&number_of_rows), sizeof(number_of_rows));
+    fin.read(reinterpret_cast<char *>(&number_of_columns), sizeof(number_of_columns));
+
+    auto read_names = [&fin] (std::vector<std::string> & names, uint64_t const count)
+    {
+        names.resize(count);
+        for (auto & name : names)
+        {
+            uint64_t length{};
+            fin.read(reinterpret_cast<char *>(&length), sizeof(length));
+            name.resize(length);
+            fin.read(name.data(), length);
+        }
+    };
+
+    std::vector<std::string> column_names{};
+    std::vector<std::string> row_names{};
+    read_names(column_names, number_of_columns);
+    read_names(row_names, number_of_rows);
+
+    if (!fin)
+        throw std::runtime_error{"Binary matrix is truncated."};
+
+    on_columns(column_names);
+
+    std::vector<double> values(number_of_columns);
+    for (auto const & row_name : row_names)
+    {
+        fin.read(reinterpret_cast<char *>(values.data()), values.size() * sizeof(double));
+
+        if (!fin)
+            throw std::runtime_error{"Binary matrix is truncated."};
+
+        on_row(row_name, values);
+    }
+}
+
+inline distance_matrix read_binary_matrix(std::istream & fin)
+{
+    distance_matrix matrix{};
+    read_binary_matrix_rows(fin,
+                            [&] (std::vector<std::string> const & names) { matrix.column_names = names; },
+                            [&] (std::string const & name, std::vector<double> const & values)
+                            {
+                                matrix.row_names.push_back(name);
+                                matrix.values.insert(matrix.values.end(), values.begin(), values.end());
+                            });
+    return matrix;
+}
+
+inline void write_binary_matrix(distance_matrix const & matrix, std::ostream & fout)
+{
+    uint64_t const number_of_rows{matrix.rows()};
+    uint64_t const number_of_columns{matrix.columns()};
+
+    fout.write(binary_matrix_magic, sizeof(binary_matrix_magic));
+    fout.write(reinterpret_cast<char const *>(&binary_matrix_version), sizeof(binary_matrix_version));
+    fout.write(reinterpret_cast<char const *>(&number_of_rows), sizeof(number_of_rows));
+    fout.write(reinterpret_cast<char const *>(&number_of_columns), sizeof(number_of_columns));
+
+    auto write_names = [&fout] (std::vector<std::string> const & names)
+    {
+        for (auto const & name : names)
+        {
+            uint64_t const length{name.size()};
+            fout.write(reinterpret_cast<char const *>(&length), sizeof(length));
+            fout.write(name.data(), length);
+        }
+    };
+
+    write_names(matrix.column_names);
+    write_names(matrix.row_names);
+
+    fout.write(reinterpret_cast<char const *>(matrix.values.data()), matrix.values.size() * sizeof(double));
+}
+
+inline bool is_binary_matrix(std::filesystem::path const & filename)
+{
+    std::ifstream fin{filename, std::ios::binary};
+    char magic[sizeof(binary_matrix_magic)]{};
+    fin.read(magic, sizeof(magic));
+    return fin && std::memcmp(magic, binary_matrix_magic, sizeof(magic)) == 0;
+}
+
+// reads either format, the binary one is detected by its magic string
+inline distance_matrix read_matrix(std::filesystem::path const & filename)
+{
+    bool const binary = is_binary_matrix(filename);
+    std::ifstream fin{filename, binary ? std::ios::binary : std::ios::in};
+
+    if (!fin.good())
+        throw std::runtime_error{"Could not open file " + filename.string()};
+
+    return binary ? read_binary_matrix(fin) : read_text_matrix(fin);
+}
+
+// read_matrix() one row at a time, see read_text_matrix_rows()
+template <typename columns_fn_t, typename row_fn_t>
+void read_matrix_rows(std::filesystem::path const & filename, columns_fn_t && on_columns, row_fn_t && on_row)
+{
+    bool const binary = is_binary_matrix(filename);
+    std::ifstream fin{filename, binary ? std::ios::binary : std::ios::in};
+
+    if (!fin.good())
+        throw std::runtime_error{"Could not open file " + filename.string()};
+
+    if (binary)
+        read_binary_matrix_rows(fin, on_columns, on_row);
+    else
+        read_text_matrix_rows(fin, on_columns, on_row);
+}
+
+inline void write_matrix(distance_matrix const & matrix, std::filesystem::path const & filename, bool const binary)
+{
+    std::ofstream fout{filename, binary ? std::ios::binary : std::ios::out};
+
+    if (!fout.good())
+        throw std::runtime_error{"Could not open file " + filename.string()};
+
+    if (binary)
+        write_binary_matrix(matrix, fout);
+    else
+        write_text_matrix(matrix, fout);
+}
@@ -0,0 +1,286 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+// The counters of one worker thread. Only the owning thread writes them (a relaxed load and store, no locked
+// instruction), the reporting thread reads them. Each thread's counters are on their own cache line.
+struct alignas(64) thread_counters
+{
+    std::atomic<uint64_t> queries{0};
+    std::atomic<uint64_t> bases{0};
+    std::atomic<uint64_t> hashes{0};
+    std::atomic<uint64_t> busy_ns{0};
+
+    // a query with `bases` bases and `hashes` counted hashes that was started at `start` is done
+    void query_done(uint64_t const query_bases,
+                    uint64_t const query_hashes,
+                    std::chrono::steady_clock::time_point const start)
+    {
+        uint64_t const ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                                                 start).count();
+        increment(queries, 1);
+        increment(bases, query_bases);
+        increment(hashes, query_hashes);
+        increment(busy_ns, ns);
+    }
+
+private:
+    static void increment(std::atomic<uint64_t> & counter, uint64_t const value)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+};
+
+/* Progress of a long-running search. Workers call register_thread() once and report every finished query to their
+ * counters. Every `interval`, a reporting thread sums the counters and
+ *   - rewrites `metrics_file` in the Prometheus text format (written to a temporary file and renamed, so a scraper or
+ *     the node_exporter textfile collector never sees a partial file),
+ *   - with `progress`, prints a progress line with throughput and ETA to stderr.
+ * Gauges, e.g. queue depths, are read from callbacks; objects they read must outlive the job_metrics.
+ * Without a metrics file and without progress, only the counters are kept and no thread is started.
+ */
+class job_metrics
+{
+public:
+    job_metrics(std::filesystem::path const & metrics_file,
+                bool const progress,
+                std::chrono::seconds const interval,
+                uint64_t const total_queries) :
+        metrics_file{metrics_file},
+        progress{progress},
+        interval{std::max<std::chrono::seconds>(interval, std::chrono::seconds{1})},
+        total_queries{total_queries}
+    {
+        start_time = last_time = std::chrono::steady_clock::now();
+
+        if (!metrics_file.empty() || progress)
+            reporter = std::thread{[this] () { report_loop(); }};
+    }
+
+    job_metrics(job_metrics const &) = delete;
+    job_metrics & operator=(job_metrics const &) = delete;
+
+    ~job_metrics()
+    {
+        if (!reporter.joinable())
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            stopping = true;
+        }
+        stopped.notify_one();
+        reporter.join();
+    }
+
+    thread_counters & register_thread()
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        return threads.emplace_back();
+    }
+
+    void add_gauge(std::string name, std::string help, std::function<uint64_t()> value)
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        gauges.push_back(gauge{std::move(name), std::move(help), std::move(value)});
+    }
+
+private:
+    struct gauge
+    {
+        std::string name{};
+        std::string help{};
+        std::function<uint64_t()> value{};
+    };
+
+    struct totals
+    {
+        uint64_t queries{0};
+        uint64_t bases{0};
+        uint64_t hashes{0};
+        std::vector<uint64_t> busy_ns{};
+        std::vector<std::pair<gauge, uint64_t>> gauges{}; // with their values
+    };
+
+    void report_loop()
+    {
+        std::unique_lock<std::mutex> lock{mutex};
+
+        while (true)
+        {
+            bool const stop = stopped.wait_for(lock, interval, [this] () { return stopping; });
+
+            // the file is written without the lock, a slow file system must not block register_thread()
+            totals current = snapshot();
+            lock.unlock();
+
+            try
+            {
+                report(std::move(current));
+            }
+            catch (std::exception const & e) // metrics must not end the search
+            {
+                std::cerr << "[WARNING] Could not write metrics: " << e.what() << '\n';
+            }
+
+            lock.lock();
+            if (stop)
+                break;
+        }
+    }
+
+    // called with `mutex` held
+    totals snapshot() const
+    {
+        totals current{};
+        for (auto const & counters : threads)
+        {
+            current.queries += counters.queries.load(std::memory_order_relaxed);
+            current.bases += counters.bases.load(std::memory_order_relaxed);
+            current.hashes += counters.hashes.load(std::memory_order_relaxed);
+            current.busy_ns.push_back(counters.busy_ns.load(std::memory_order_relaxed));
+        }
+
+        for (auto const & g : gauges)
+            current.gauges.emplace_back(g, g.value());
+
+        return current;
+    }
+
+    void report(totals current)
+    {
+        auto const now = std::chrono::steady_clock::now();
+        double const seconds = std::chrono::duration<double>(now - last_time).count();
+        double const elapsed = std::chrono::duration<double>(now - start_time).count();
+
+        last.busy_ns.resize(current.busy_ns.size(), 0);
+
+        auto rate = [&] (uint64_t const value, uint64_t const previous)
+        {
+            return (seconds > 0.0) ? static_cast<double>(value - previous) / seconds : 0.0;
+        };
+
+        double const queries_per_second = rate(current.queries, last.queries);
+        double const bases_per_second = rate(current.bases, last.bases);
+        double const hashes_per_second = rate(current.hashes, last.hashes);
+
+        // from the average rate since the start, which is steadier than the last interval
+        double eta{-1.0};
+        if (total_queries > 0 && current.queries > 0)
+            eta = static_cast<double>(total_queries - std::min(current.queries, total_queries)) * elapsed /
+                  static_cast<double>(current.queries);
+
+        uint64_t const rss = resident_memory();
+
+        if (!metrics_file.empty())
+        {
+            std::ostringstream out{};
+            auto metric = [&] (std::string const & name, std::string const & type, std::string const & help,
+                               auto const value)
+            {
+                out << "# HELP " << name << ' ' << help << '\n'
+                    << "# TYPE " << name << ' ' << type << '\n'
+                    << name << ' ' << value << '\n';
+            };
+
+            metric("smash_queries_done_total", "counter", "Queries searched.", current.queries);
+            metric("smash_queries", "gauge", "Queries of this job, 0 if unknown.", total_queries);
+            metric("smash_bases_total", "counter", "Bases of the searched queries.", current.bases);
+            metric("smash_hashes_total", "counter", "Hashes counted in the index.", current.hashes);
+            metric("smash_queries_per_second", "gauge", "Queries per second in the last interval.",
+                   queries_per_second);
+            metric("smash_bases_per_second", "gauge", "Bases per second in the last interval.", bases_per_second);
+            metric("smash_hashes_per_second", "gauge", "Hashes per second in the last interval.", hashes_per_second);
+            metric("smash_elapsed_seconds", "gauge", "Seconds since the search started.", elapsed);
+            metric("smash_eta_seconds", "gauge", "Estimated seconds until all queries are done, -1 if unknown.", eta);
+            metric("smash_resident_memory_bytes", "gauge", "Resident set size.", rss);
+
+            for (auto const & [g, value] : current.gauges)
+                metric(g.name, "gauge", g.help, value);
+
+            out << "# HELP smash_thread_utilisation Fraction of the last interval a worker thread was busy.\n"
+                << "# TYPE smash_thread_utilisation gauge\n";
+            for (size_t t = 0; t < current.busy_ns.size(); ++t)
+            {
+                double const busy = (seconds > 0.0) ? (current.busy_ns[t] - last.busy_ns[t]) / (seconds * 1e9) : 0.0;
+                out << "smash_thread_utilisation{thread=\"" << t << "\"} " << std::min(busy, 1.0) << '\n';
+            }
+
+            std::filesystem::path const temporary{metrics_file.string() + ".tmp"};
+            {
+                std::ofstream fout{temporary};
+                if (!fout.good())
+                    throw std::runtime_error{"Could not open file " + temporary.string()};
+                fout << out.str();
+            }
+            std::filesystem::rename(temporary, metrics_file);
+        }
+
+        if (progress)
+        {
+            std::ostringstream line{};
+            line << std::fixed;
+            line.precision(2);
+            line << "[PROGRESS] " << current.queries;
+            if (total_queries > 0)
+                line << '/' << total_queries << " queries (" << 100.0 * current.queries / total_queries << "%)";
+            else
+                line << " queries";
+            line << ", " << queries_per_second << " queries/s, " << bases_per_second / 1e6 << " Mbp/s, "
+                 << hashes_per_second / 1e6 << " M hashes/s, RSS " << rss / static_cast<double>(1ULL << 30) << " GiB";
+            if (eta >= 0.0)
+            {
+                uint64_t const eta_seconds = static_cast<uint64_t>(eta);
+                line << ", ETA " << eta_seconds / 3600 << "h" << (eta_seconds / 60) % 60 << "m" << eta_seconds % 60
+                     << "s";
+            }
+            std::cerr << line.str() << std::endl;
+        }
+
+        last = std::move(current);
+        last_time = now;
+    }
+
+    static uint64_t resident_memory()
+    {
+        std::ifstream statm{"/proc/self/statm"};
+        uint64_t size{0};
+        uint64_t resident{0};
+        statm >> size >> resident;
+        return resident * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    }
+
+    std::filesystem::path metrics_file{};
+    bool progress{false};
+    std::chrono::seconds interval{};
+    uint64_t total_queries{0};
+
+    std::mutex mutex{};
+    std::condition_variable stopped{};
+    bool stopping{false};
+    std::deque<thread_counters> threads{}; // a deque does not move its elements
+    std::vector<gauge> gauges{};
+
+    // only used by the reporting thread
+    std::chrono::steady_clock::time_point start_time{};
+    std::chrono::steady_clock::time_point last_time{};
+    totals last{};
+
+    std::thread reporter{};
+};
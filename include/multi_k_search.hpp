@@ -0,0 +1,12 @@
+#pragma once
+
+#include <raptor/index.hpp>
+
+#include "options.hpp"
+
+std::vector<uint64_t> user_bin_sizes(raptor::raptor_index<raptor::index_structure::hibf> const & index,
+                                     std::filesystem::path const & index_file,
+                                     uint8_t const kmer_size,
+                                     smash_options const & options);
+
+void search_multi_k(smash_options const & options);
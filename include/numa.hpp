@@ -0,0 +1,174 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/* Minimal NUMA support using the Linux sysfs topology and the set_mempolicy syscall (no libnuma needed).
+ *
+ * - interleave_memory()/bind_memory(node) change the memory policy of the calling thread, i.e. of all pages that are
+ *   first touched by it afterwards (e.g. while loading an index). reset_memory_policy() restores the default.
+ * - assign_thread() distributes the threads of a `raptor::do_parallel` call round-robin over the nodes, optionally
+ *   pins them to a core of that node, and returns the node.
+ *
+ * The nodes are the online nodes (their IDs need not be contiguous) that have a CPU the process may run on, and only
+ * those CPUs are used for pinning. Nodes are numbered 0 ... nodes() - 1 in the order of their IDs.
+ *
+ * On single-node machines and on other platforms everything is a no-op with one node.
+ */
+class numa_placement
+{
+public:
+    numa_placement()
+    {
+#ifdef __linux__
+        std::filesystem::path const node_directory{"/sys/devices/system/node"};
+
+        // the CPUs of the process' cpuset, e.g. restricted by taskset or a container
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        bool const know_allowed = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+        for (int const id : parse_cpulist(read_line(node_directory / "online")))
+        {
+            std::vector<int> cpus{};
+            for (int const cpu : parse_cpulist(read_line(node_directory / ("node" + std::to_string(id)) / "cpulist")))
+                if (!know_allowed || (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)))
+                    cpus.push_back(cpu);
+
+            if (!cpus.empty())
+            {
+                node_ids.push_back(id);
+                node_cpus.push_back(std::move(cpus));
+            }
+        }
+#endif
+        if (node_cpus.empty())
+        {
+            node_ids.push_back(0);
+            node_cpus.emplace_back();
+        }
+    }
+
+    size_t nodes() const
+    {
+        return node_cpus.size();
+    }
+
+    bool interleave_memory() const
+    {
+#ifdef __linux__
+        if (nodes() > 1)
+            return set_memory_policy(MPOL_INTERLEAVE, node_ids);
+#endif
+        return false;
+    }
+
+    bool bind_memory([[maybe_unused]] size_t const node) const
+    {
+#ifdef __linux__
+        if (nodes() > 1 && node < nodes())
+            return set_memory_policy(MPOL_BIND, {node_ids[node]});
+#endif
+        return false;
+    }
+
+    void reset_memory_policy() const
+    {
+#ifdef __linux__
+        if (nodes() > 1)
+            syscall(SYS_set_mempolicy, MPOL_DEFAULT, nullptr, 0);
+#endif
+    }
+
+    // must be called before every `raptor::do_parallel`
+    void reset_threads()
+    {
+        next_thread = 0;
+    }
+
+    // to be called at the beginning of a worker; returns the node the calling thread belongs to
+    size_t assign_thread([[maybe_unused]] bool const pin)
+    {
+        size_t const thread = next_thread++;
+        size_t const node = thread % nodes();
+
+#ifdef __linux__
+        auto const & cpus = node_cpus[node];
+        if (pin && !cpus.empty())
+        {
+            int const cpu = cpus[(thread / nodes()) % cpus.size()];
+            cpu_set_t cpu_set;
+            CPU_ZERO(&cpu_set);
+            CPU_SET(cpu, &cpu_set);
+            if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) != 0 && !pin_warned.exchange(true))
+                std::cerr << "[WARNING] Could not pin a thread to CPU " << cpu << ", the threads are not pinned.\n";
+        }
+#endif
+        return node;
+    }
+
+private:
+#ifdef __linux__
+    // `nodes` are node IDs
+    static bool set_memory_policy(int const mode, std::vector<int> const & nodes)
+    {
+        size_t constexpr bits = sizeof(unsigned long) * 8;
+        std::vector<unsigned long> mask((std::ranges::max(nodes) / bits) + 1, 0UL);
+        for (int const id : nodes)
+            mask[id / bits] |= 1UL << (id % bits);
+
+        return syscall(SYS_set_mempolicy, mode, mask.data(), mask.size() * bits + 1) == 0;
+    }
+#endif
+
+    static std::string read_line(std::filesystem::path const & filename)
+    {
+        std::ifstream fin{filename};
+        std::string line{};
+        std::getline(fin, line);
+        return line;
+    }
+
+    // e.g. "0-3,8-11"
+    static std::vector<int> parse_cpulist(std::string const & line)
+    {
+        std::vector<int> cpus{};
+        size_t pos{0};
+
+        while (pos < line.size())
+        {
+            size_t const comma = std::min(line.find(',', pos), line.size());
+            std::string const range = line.substr(pos, comma - pos);
+            size_t const dash = range.find('-');
+
+            if (!range.empty())
+            {
+                int const first = std::stoi(range.substr(0, dash));
+                int const last = (dash == std::string::npos) ? first : std::stoi(range.substr(dash + 1));
+                for (int cpu = first; cpu <= last; ++cpu)
+                    cpus.push_back(cpu);
+            }
+
+            pos = comma + 1;
+        }
+
+        return cpus;
+    }
+
+    std::vector<int> node_ids{};
+    std::vector<std::vector<int>> node_cpus{};
+    std::atomic<size_t> next_thread{0};
+    std::atomic<bool> pin_warned{false};
+};
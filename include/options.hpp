@@ -11,14 +11,49 @@ struct smash_options
     std::filesystem::path input_file{};
     std::filesystem::path index_file{};
     std::filesystem::path output_file{};
+    std::filesystem::path matrix_file{};
+    std::filesystem::path base_index_file{};
+    std::filesystem::path reference_file{};
     uint32_t sketch_size{10000};
+    double sketch_error{0.0};
+    uint32_t min_sketch_size{100};
+    uint32_t max_sketch_size{100000};
+    uint64_t scale{0};
     uint8_t kmer_size{32};
+    uint8_t min_abundance{1};
+    uint64_t abundance_memory{64};
+    uint64_t early_stop{0};
+    uint8_t hll_bits{12};
     double fpr{0.0};
+    double cluster_threshold{0.0};
     uint8_t threads{32};
+    uint64_t memory_budget{0};
+    uint64_t index_memory{0};
+    uint32_t checkpoint_interval{0};
     bool write_time{true};
     bool no_sketching{false};
+    bool hll{false};
+    bool binary_output{false};
+    bool resume{false};
+    bool pin_threads{false};
+    bool ordered{false};
+    bool per_record{false};
+    std::string numa{"none"};
+    std::vector<uint8_t> kmer_sizes{};
+    std::vector<std::filesystem::path> index_files{};
+    std::string stream{};
+    std::string stream_group{"records"};
+    uint64_t stream_records{100000};
+    char stream_separator{'.'};
+    uint32_t shard{0};
+    uint32_t shards{1};
+    std::string shard_by{"index"};
+    std::filesystem::path metrics_file{};
+    bool progress{false};
+    uint64_t metrics_interval{10};
 
     // data
     std::vector<std::string> files;
+    std::vector<std::string> references;
     robin_hood::unordered_map<std::string, uint64_t> sizes;
 };
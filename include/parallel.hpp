@@ -0,0 +1,77 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <limits>
+#include <vector>
+
+// Hands out [0, size) in chunks of `chunk_size`, in increasing order, to whichever thread asks next.
+class chunk_queue
+{
+public:
+    chunk_queue(size_t const size, size_t const chunk_size) : size{size}, chunk_size{std::max<size_t>(chunk_size, 1)}
+    {}
+
+    // the next chunk is [start, end); false if there is none left
+    bool pop(size_t & start, size_t & end)
+    {
+        start = next.fetch_add(chunk_size, std::memory_order_relaxed);
+        if (start >= size)
+            return false;
+
+        end = std::min(start + chunk_size, size);
+        return true;
+    }
+
+    // hands out no further chunks
+    void stop()
+    {
+        next.store(std::numeric_limits<size_t>::max() / 2, std::memory_order_relaxed);
+    }
+
+private:
+    size_t size{};
+    size_t chunk_size{};
+    std::atomic<size_t> next{0};
+};
+
+/* Dynamic scheduling: worker(chunks) is called once on each of `threads` threads and processes chunks until the queue
+ * is empty, so per-thread state is set up once per thread. Unlike the fixed ranges of raptor::do_parallel, all threads
+ * work on neighbouring records, which keeps the reorder buffer of an ordered output small and balances the load when
+ * records differ in size. Exceptions of the workers are rethrown. After the first exception, no further chunks are
+ * handed out and `on_failure` is called, e.g. checkpointed_out::abort() to release threads waiting for the row of the
+ * failed worker.
+ */
+template <typename worker_t>
+void do_parallel_dynamic(worker_t && worker,
+                         size_t const size,
+                         size_t const threads,
+                         size_t const chunk_size,
+                         std::function<void()> const & on_failure = {})
+{
+    chunk_queue chunks{size, chunk_size};
+
+    std::vector<std::future<void>> tasks{};
+    for (size_t i = 0; i < std::max<size_t>(threads, 1); ++i)
+    {
+        tasks.emplace_back(std::async(std::launch::async, [&] ()
+        {
+            try
+            {
+                worker(chunks);
+            }
+            catch (...)
+            {
+                chunks.stop();
+                if (on_failure)
+                    on_failure();
+                throw;
+            }
+        }));
+    }
+
+    for (auto && task : tasks)
+        task.get();
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/* LSD radix sort of 64 bit values with 8 bit digits, using `buffer` as scratch space.
+ * The histograms of all digits are computed in a single pass and digits that are the same for all values are skipped,
+ * e.g. the upper bytes of k-mer hashes for k < 32. The sorted values end up in `values`.
+ */
+inline void radix_sort(std::vector<uint64_t> & values, std::vector<uint64_t> & buffer)
+{
+    size_t constexpr digits{8};
+    size_t constexpr buckets{256};
+
+    if (values.size() < 2)
+        return;
+
+    std::array<std::array<size_t, buckets>, digits> histograms{};
+
+    for (uint64_t const value : values)
+        for (size_t digit = 0; digit < digits; ++digit)
+            ++histograms[digit][(value >> (8 * digit)) & 0xFF];
+
+    buffer.resize(values.size());
+
+    for (size_t digit = 0; digit < digits; ++digit)
+    {
+        auto & histogram = histograms[digit];
+
+        if (std::ranges::find(histogram, values.size()) != histogram.end()) // all values have the same digit
+            continue;
+
+        size_t offset{0};
+        for (auto & count : histogram) // exclusive prefix sum
+            offset += std::exchange(count, offset);
+
+        for (uint64_t const value : values)
+            buffer[histogram[(value >> (8 * digit)) & 0xFF]++] = value;
+
+        values.swap(buffer);
+    }
+}
+
+// sorts and removes duplicates
+inline void radix_sort_unique(std::vector<uint64_t> & values, std::vector<uint64_t> & buffer)
+{
+    radix_sort(values, buffer);
+    auto const [first, last] = std::ranges::unique(values);
+    values.erase(first, last);
+}
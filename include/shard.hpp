@@ -0,0 +1,54 @@
+#pragma once
+
+#include <algorithm>
+#include <filesystem>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Splits the queries for runs on several nodes: shard `shard` of `shards` gets
+//   by "index": the `shard`-th of `shards` contiguous blocks of (almost) equal length,
+//   by "size":  a subset chosen such that all shards have about the same total file size (largest files first, each
+//               to the shard with the smallest total so far; ties go to the earlier file and the lower shard).
+// Both only depend on the list of files (and their sizes), so every shard of a job array computes the same split.
+// The queries of a shard keep their order of `files`.
+inline std::vector<std::string> select_shard(std::vector<std::string> const & files,
+                                             size_t const shard,
+                                             size_t const shards,
+                                             std::string const & by)
+{
+    if (shards == 0 || shard >= shards)
+        throw std::runtime_error{"--shard must be smaller than --shards."};
+
+    if (by == "index")
+    {
+        size_t const start = shard * files.size() / shards;
+        size_t const end = (shard + 1) * files.size() / shards;
+        return {files.begin() + start, files.begin() + end};
+    }
+
+    std::vector<uint64_t> sizes(files.size());
+    for (size_t i = 0; i < files.size(); ++i)
+        sizes[i] = std::filesystem::file_size(files[i]);
+
+    std::vector<size_t> order(files.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::ranges::stable_sort(order, [&] (size_t const a, size_t const b) { return sizes[a] > sizes[b]; });
+
+    std::vector<uint64_t> totals(shards, 0);
+    std::vector<bool> selected(files.size(), false);
+    for (size_t const i : order)
+    {
+        size_t const target = std::ranges::min_element(totals) - totals.begin();
+        totals[target] += sizes[i];
+        selected[i] = (target == shard);
+    }
+
+    std::vector<std::string> result{};
+    for (size_t i = 0; i < files.size(); ++i)
+        if (selected[i])
+            result.push_back(files[i]);
+
+    return result;
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+#include "options.hpp"
+
+void search_index_shards(smash_options const & options);
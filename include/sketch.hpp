@@ -1,87 +1,312 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
 #include <vector>
 #include <queue>
 
+#include <seqan3/alphabet/concept.hpp>
 #include <seqan3/search/views/kmer_hash.hpp>
 #include <seqan3/search/views/minimiser_hash.hpp>
 
 #include <raptor/adjust_seed.hpp>
 
+#include <robin_hood.h>
+
+// A max-heap of distinct values: push() ignores a value that is already in the queue. A k-mer of a read set occurs
+// once per read covering it, but may enter a sketch only once.
 template <typename T>
 struct my_priority_queue : public std::priority_queue<T>
 {
+    // returns whether `value` was added
+    bool push(T const & value)
+    {
+        if (!members.insert(value).second)
+            return false;
+
+        std::priority_queue<T>::push(value);
+        return true;
+    }
+
+    void pop()
+    {
+        members.erase(this->top());
+        std::priority_queue<T>::pop();
+    }
+
+    bool contains(T const & value) const
+    {
+        return members.contains(value);
+    }
+
     auto get_underlying_container()
     {
         return this->c;
     }
+
+    std::vector<T> const & container() const
+    {
+        return this->c;
+    }
+
+    // keeps the allocated memory
+    void clear()
+    {
+        this->c.clear();
+        members.clear();
+    }
+
+    void reserve(size_t const size)
+    {
+        this->c.reserve(size);
+        members.reserve(size);
+    }
+
+private:
+    robin_hood::unordered_flat_set<T> members{};
 };
 
-template <typename range_t>
-void init_sketch(range_t && input, uint8_t const kmer_size, uint32_t const sketch_size, my_priority_queue<uint64_t> & sketch)
+// k-mer sizes for which the hashing is compiled with k as a constant.
+// A k-mer size is passed either as uint8_t (generic) or as std::integral_constant<uint8_t, k> (specialised).
+template <uint8_t kmer_size>
+using fixed_kmer_size = std::integral_constant<uint8_t, kmer_size>;
+
+// Calls fn(fixed_kmer_size<k>{}) for the common k-mer sizes and fn(kmer_size) otherwise.
+template <typename fn_t>
+decltype(auto) with_kmer_size(uint8_t const kmer_size, fn_t && fn)
+{
+    switch (kmer_size)
+    {
+        case 15: return fn(fixed_kmer_size<15>{});
+        case 16: return fn(fixed_kmer_size<16>{});
+        case 19: return fn(fixed_kmer_size<19>{});
+        case 21: return fn(fixed_kmer_size<21>{});
+        case 23: return fn(fixed_kmer_size<23>{});
+        case 31: return fn(fixed_kmer_size<31>{});
+        case 32: return fn(fixed_kmer_size<32>{});
+        default: return fn(kmer_size);
+    }
+}
+
+// generic: the canonical k-mer hashes as raptor stores them
+template <typename range_t, typename callback_t>
+void for_each_kmer_hash(range_t && input, uint8_t const kmer_size, callback_t && callback)
 {
     auto hashes = input | seqan3::views::minimiser_hash(seqan3::shape{seqan3::ungapped{kmer_size}},
                                                         seqan3::window_size{kmer_size},
                                                         seqan3::seed{raptor::adjust_seed(kmer_size)});
-    auto hashes_it = hashes.begin();
 
-    // initialise sketch with the first hashes
-    for (size_t i = 0; i < sketch_size && hashes_it != hashes.end(); ++i, ++hashes_it)
-        sketch.push(*hashes_it);
+    for (uint64_t const hash : hashes)
+        callback(hash);
+}
+
+// specialised: the same hashes as above (minimiser_hash with window_size == kmer_size is
+// min(forward ^ seed, reverse_complement ^ seed)), computed by a rolling hash with constexpr mask, shift and seed.
+template <typename range_t, uint8_t kmer_size, typename callback_t>
+void for_each_kmer_hash(range_t && input, fixed_kmer_size<kmer_size>, callback_t && callback)
+{
+    static_assert(kmer_size > 0 && kmer_size <= 32);
+
+    constexpr uint64_t mask = (kmer_size == 32) ? std::numeric_limits<uint64_t>::max()
+                                                : (1ULL << (2 * kmer_size)) - 1;
+    constexpr uint64_t reverse_shift = 2 * (kmer_size - 1);
+    constexpr uint64_t seed = raptor::adjust_seed(kmer_size);
+
+    uint64_t forward{0};
+    uint64_t reverse{0};
+    auto it = std::ranges::begin(input);
+    auto const end = std::ranges::end(input);
+
+    // fill the first k-mer
+    for (uint8_t i = 1; i < kmer_size && it != end; ++i, ++it)
+    {
+        uint64_t const rank = seqan3::to_rank(*it);
+        forward = (forward << 2) | rank;
+        reverse = (reverse >> 2) | ((3 - rank) << reverse_shift);
+    }
+
+    for (; it != end; ++it)
+    {
+        uint64_t const rank = seqan3::to_rank(*it);
+        forward = ((forward << 2) | rank) & mask;
+        reverse = (reverse >> 2) | ((3 - rank) << reverse_shift);
+        callback(std::min(forward ^ seed, reverse ^ seed));
+    }
+}
+
+/* Several k-mer sizes (at most 32) in one pass: all k share one forward and one reverse complement value of the
+ * largest k. The forward k-mer is the lowest 2k bits of the forward value, its reverse complement the highest 2k bits
+ * of the reverse value. callback(j, hash) receives the hashes of kmer_sizes[j], identical to for_each_kmer_hash.
+ */
+template <typename range_t, typename callback_t>
+void for_each_multi_kmer_hash(range_t && input, std::vector<uint8_t> const & kmer_sizes, callback_t && callback)
+{
+    uint8_t const max_kmer_size = std::ranges::max(kmer_sizes);
+    uint64_t const reverse_shift = 2 * (max_kmer_size - 1);
+
+    std::vector<uint64_t> masks{};
+    std::vector<uint64_t> seeds{};
+    for (uint8_t const kmer_size : kmer_sizes)
+    {
+        masks.push_back((kmer_size == 32) ? std::numeric_limits<uint64_t>::max() : (1ULL << (2 * kmer_size)) - 1);
+        seeds.push_back(raptor::adjust_seed(kmer_size));
+    }
+
+    uint64_t forward{0};
+    uint64_t reverse{0};
+    size_t length{0};
 
-    while (hashes_it != hashes.end())
+    for (auto const symbol : input)
     {
-        if (*hashes_it < sketch.top())
+        uint64_t const rank = seqan3::to_rank(symbol);
+        forward = (forward << 2) | rank;
+        reverse = (reverse >> 2) | ((3 - rank) << reverse_shift);
+        ++length;
+
+        for (size_t j = 0; j < kmer_sizes.size(); ++j)
         {
-            sketch.pop();
-            sketch.push(*hashes_it);
+            if (length < kmer_sizes[j])
+                continue;
+
+            uint64_t const forward_kmer = forward & masks[j];
+            uint64_t const reverse_kmer = reverse >> (2 * (max_kmer_size - kmer_sizes[j]));
+            callback(j, std::min(forward_kmer ^ seeds[j], reverse_kmer ^ seeds[j]));
         }
-        ++hashes_it;
     }
 }
 
-template <typename range_t>
-void add_to_sketch(range_t && input, uint8_t const kmer_size, my_priority_queue<uint64_t> & sketch)
+// returns whether the sketch changed
+inline bool insert_into_sketch(uint64_t const hash, uint32_t const sketch_size, my_priority_queue<uint64_t> & sketch)
 {
-    auto hashes = input | seqan3::views::minimiser_hash(seqan3::shape{seqan3::ungapped{kmer_size}},
-                                                        seqan3::window_size{kmer_size},
-                                                        seqan3::seed{raptor::adjust_seed(kmer_size)});
-    auto hashes_it = hashes.begin();
+    // initialise sketch with the first hashes
+    if (sketch.size() < sketch_size)
+    {
+        return sketch.push(hash);
+    }
+    else if (hash < sketch.top() && !sketch.contains(hash))
+    {
+        sketch.pop();
+        sketch.push(hash);
+        return true;
+    }
+
+    return false;
+}
 
-    while (hashes_it != hashes.end())
+template <typename range_t, typename kmer_size_t>
+void init_sketch(range_t && input, kmer_size_t const kmer_size, uint32_t const sketch_size, my_priority_queue<uint64_t> & sketch)
+{
+    for_each_kmer_hash(input, kmer_size, [&] (uint64_t const hash)
+    {
+        insert_into_sketch(hash, sketch_size, sketch);
+    });
+}
+
+template <typename range_t, typename kmer_size_t>
+void add_to_sketch(range_t && input, kmer_size_t const kmer_size, my_priority_queue<uint64_t> & sketch)
+{
+    for_each_kmer_hash(input, kmer_size, [&] (uint64_t const hash)
     {
-        if (*hashes_it < sketch.top())
+        if (hash < sketch.top() && !sketch.contains(hash))
         {
             sketch.pop();
-            sketch.push(*hashes_it);
+            sketch.push(hash);
         }
-        ++hashes_it;
-    }
+    });
 }
 
 // can be used if only hashing a single sequence
-template <typename range_t>
-std::vector<uint64_t> sketch_min_hash(range_t && input, uint8_t const kmer_size, uint32_t const sketch_size)
+template <typename range_t, typename kmer_size_t>
+std::vector<uint64_t> sketch_min_hash(range_t && input, kmer_size_t const kmer_size, uint32_t const sketch_size)
 {
     my_priority_queue<uint64_t> sketch;
+    init_sketch(input, kmer_size, sketch_size, sketch);
+    return sketch.get_underlying_container();
+}
 
-    auto hashes = input | seqan3::views::minimiser_hash(seqan3::shape{seqan3::ungapped{kmer_size}},
-                                                        seqan3::window_size{kmer_size},
-                                                        seqan3::seed{raptor::adjust_seed(kmer_size)});
-    auto hashes_it = hashes.begin();
+/* Sketch size for a query with `cardinality` distinct k-mers, such that the standard error of the containment estimate
+ * is at most `error` (worst case C = 0.5). Sampling k of n k-mers without replacement has
+ * Var = C(1 - C) / k * (n - k) / (n - 1), which gives k = n * k0 / (n + k0 - 1) with k0 = 0.25 / error^2.
+ * Small genomes therefore get sketches much smaller than k0, large genomes approach k0.
+ * Requires 0 < min_sketch_size <= max_sketch_size, which the option parsing ensures.
+ */
+inline uint32_t adaptive_sketch_size(uint64_t const cardinality,
+                                     double const error,
+                                     uint32_t const min_sketch_size,
+                                     uint32_t const max_sketch_size)
+{
+    double const k0 = 0.25 / (error * error);
+    double const n = static_cast<double>(std::max<uint64_t>(cardinality, 1));
+    double const k = n * k0 / (n + k0 - 1.0);
 
-    // initialise sketch with the first hashes
-    for (size_t i = 0; i < sketch_size && i < hashes.size(); ++i, ++hashes_it)
-        sketch.push(*hashes_it);
+    return std::clamp(static_cast<uint32_t>(std::min(std::ceil(k), static_cast<double>(max_sketch_size))),
+                      min_sketch_size,
+                      max_sketch_size);
+}
+
+// FracMinHash ("scaled" sketch): keep every hash below max_hash / scale.
+// The k-mer hashes of seqan3 are in [0, 4^k), so max_hash depends on the k-mer size.
+inline uint64_t scaled_threshold(uint8_t const kmer_size, uint64_t const scale)
+{
+    uint64_t const max_hash = (kmer_size >= 32) ? std::numeric_limits<uint64_t>::max()
+                                                : (1ULL << (2 * kmer_size)) - 1;
+    return max_hash / scale;
+}
 
-    while (hashes_it != hashes.end())
+// Sketches of several sequences (or several files) are merged by simply appending to the same vector.
+template <typename range_t, typename kmer_size_t>
+void add_to_scaled_sketch(range_t && input, kmer_size_t const kmer_size, uint64_t const threshold, std::vector<uint64_t> & sketch)
+{
+    for_each_kmer_hash(input, kmer_size, [&] (uint64_t const hash)
     {
-        if (*hashes_it < sketch.top())
-        {
-            sketch.pop();
-            sketch.push(*hashes_it);
-        }
+        if (hash <= threshold)
+            sketch.push_back(hash);
+    });
+}
+
+// The fraction of k-mers whose hash is at most `hash`. A k-mer hash is the minimum of the (seeded) hashes of the
+// k-mer and its reverse complement, two roughly independent uniform values in [0, max_hash], so the fraction is
+// 1 - (1 - hash / max_hash)^2, about twice the fraction of a single uniform hash.
+inline double fraction_of_hashes_below(uint64_t const hash, uint8_t const kmer_size)
+{
+    double const u = static_cast<double>(hash) / static_cast<double>(scaled_threshold(kmer_size, 1));
+    return u * (2.0 - u);
+}
+
+// Number of distinct k-mers estimated from a sorted sketch: a scaled sketch samples the fraction of hashes up to its
+// threshold, for a bottom-k sketch the k-th smallest hash is expected at the fraction (k - 1) / n.
+// Used when the k-mers were filtered while sketching.
+inline uint64_t sketch_cardinality(std::vector<uint64_t> const & hashes,
+                                   uint8_t const kmer_size,
+                                   uint64_t const scale,
+                                   uint32_t const sketch_size)
+{
+    if (scale > 0)
+    {
+        double const fraction = fraction_of_hashes_below(scaled_threshold(kmer_size, scale), kmer_size);
+        return static_cast<uint64_t>(static_cast<double>(hashes.size()) / fraction);
     }
 
-    return sketch.get_underlying_container();
+    if (hashes.size() < sketch_size || hashes.back() == 0) // all k-mers are in the sketch
+        return hashes.size();
+
+    return static_cast<uint64_t>((hashes.size() - 1) / fraction_of_hashes_below(hashes.back(), kmer_size));
+}
+
+// The number of hashes a sketch sampled, i.e. the denominator of the containment estimate: all hashes of a scaled
+// sketch, at most `sketch_size` of a bottom-k sketch. A query with fewer k-mers than `sketch_size` has all of them
+// in the sketch.
+inline uint64_t sampled_hashes(std::vector<uint64_t> const & hashes, uint64_t const scale, uint32_t const sketch_size)
+{
+    return (scale > 0) ? hashes.size() : std::min<uint64_t>(sketch_size, hashes.size());
+}
+
+// sorts and removes duplicates, such that sketch.size() is the number of distinct sampled k-mers
+inline void finalise_scaled_sketch(std::vector<uint64_t> & sketch)
+{
+    std::ranges::sort(sketch);
+    auto const [first, last] = std::ranges::unique(sketch);
+    sketch.erase(first, last);
 }
@@ -0,0 +1,363 @@
+#pragma once
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <seqan3/alphabet/nucleotide/dna4.hpp>
+#include <seqan3/io/sequence_file/input.hpp>
+
+#include "count_min.hpp"
+#include "options.hpp"
+#include "sketch.hpp"
+#include "sketch_io.hpp"
+
+struct my_traits : seqan3::sequence_file_input_default_traits_dna
+{
+    using sequence_alphabet = seqan3::dna4; // instead of dna5
+};
+
+// Per-thread buffers for sketching. They are reset instead of reallocated between files, so after the first few files
+// sketching a file only allocates inside seqan3's file input.
+struct sketch_workspace
+{
+    my_priority_queue<uint64_t> heap{};
+    std::vector<uint64_t> hashes{};
+    count_min_sketch abundances{};
+    uint64_t bases{0}; // of the sequences of the last sketch, for metrics
+};
+
+/* Reads a precomputed sketch and reduces it to the sketch that would have been computed from the sequences:
+ * - scaled: a scaled sketch with a smaller or equal scale, filtered to the hashes below the threshold of `options.scale`.
+ * - bottom-k: the first `sketch_size` hashes of any sketch with at least that many hashes. A bottom-k sketch with
+ *   fewer hashes than its sketch size contains all k-mers of the file and is used as is.
+ */
+inline void read_precomputed_sketch(std::filesystem::path const & filename,
+                                    smash_options const & options,
+                                    std::vector<uint64_t> & hashes,
+                                    uint32_t const sketch_size)
+{
+    sketch_header const header = read_sketch(filename, hashes);
+
+    if (header.kmer_size != options.kmer_size)
+        throw std::runtime_error{"Sketch " + filename.string() + " was computed with k = " +
+                                 std::to_string(header.kmer_size) + " instead of k = " +
+                                 std::to_string(options.kmer_size) + '.'};
+
+    if (options.scale > 0)
+    {
+        if (header.scale == 0 || header.scale > options.scale)
+            throw std::runtime_error{"Sketch " + filename.string() + " is not a scaled sketch with a scale of at most " +
+                                     std::to_string(options.scale) + '.'};
+
+        uint64_t const threshold = scaled_threshold(options.kmer_size, options.scale);
+        hashes.erase(std::ranges::upper_bound(hashes, threshold), hashes.end());
+    }
+    else if (hashes.size() >= sketch_size)
+    {
+        hashes.resize(sketch_size);
+    }
+    else if (header.scale > 0 || hashes.size() == header.sketch_size)
+    {
+        throw std::runtime_error{"Sketch " + filename.string() + " has only " + std::to_string(hashes.size()) +
+                                 " hashes, but a sketch size of " + std::to_string(sketch_size) + " was requested."};
+    }
+}
+
+/* Early termination of bottom-k sketching (`options.early_stop`): reading a file stops after a record once the
+ * last `early_stop` k-mers did not change the sketch. For deep read sets the sketch converges after about one times
+ * coverage, every later k-mer is either already known or larger than all sketched hashes.
+ */
+struct early_stop_tracker
+{
+    uint64_t limit{0};
+    uint64_t unchanged_kmers{0};
+    uint64_t bases{0};
+    uint64_t records{0};
+
+    void update(bool const changed)
+    {
+        unchanged_kmers = changed ? 0 : unchanged_kmers + 1;
+    }
+
+    // to be called after each record, returns true if reading can stop
+    bool stable(size_t const record_length)
+    {
+        bases += record_length;
+        ++records;
+        return limit > 0 && unchanged_kmers >= limit;
+    }
+
+    void report(std::filesystem::path const & filename) const
+    {
+        std::cerr << ("Stopped sketching " + filename.string() + " after " + std::to_string(records) + " records (" +
+                      std::to_string(bases) + " bp).\n");
+    }
+};
+
+// About the number of k-mers of a sequence file, i.e. its number of bases: one per byte, four per byte if compressed.
+// Unknown (0) for anything that is not a regular file.
+inline uint64_t estimated_kmers(std::filesystem::path const & filename)
+{
+    std::error_code error{};
+    if (!std::filesystem::is_regular_file(filename, error))
+        return 0;
+
+    auto const extension = filename.extension();
+    bool const compressed = (extension == ".gz" || extension == ".bgzf" || extension == ".bz2");
+    uint64_t const size = std::filesystem::file_size(filename, error);
+    return error ? 0 : size * (compressed ? 4 : 1);
+}
+
+/* For raw reads: only k-mers that occur at least `options.min_abundance` times enter the sketch, which removes most
+ * k-mers with sequencing errors. Occurrences are counted in a count-min sketch of `options.abundance_memory` MiB
+ * per thread, and a k-mer is added at the moment its count reaches the abundance, i.e. once.
+ * A small file gets a count-min sketch of about one counter per k-mer and row, so it does not pay for clearing the
+ * whole budget. Collisions in an overfull count-min sketch let some rare k-mers through and, rarely, skip a solid one.
+ */
+inline void sketch_solid_kmers(std::filesystem::path const & filename,
+                               smash_options const & options,
+                               sketch_workspace & workspace,
+                               uint32_t const sketch_size)
+{
+    std::vector<uint64_t> & hashes = workspace.hashes;
+    my_priority_queue<uint64_t> & sketch = workspace.heap;
+    count_min_sketch & abundances = workspace.abundances;
+
+    sketch.clear();
+    sketch.reserve(sketch_size);
+    uint64_t const kmers = estimated_kmers(filename);
+    uint64_t const budget = options.abundance_memory << 20;
+    abundances.reset((kmers == 0) ? budget : std::min(budget, kmers * count_min_sketch::depth));
+    workspace.bases = 0;
+
+    uint64_t const threshold = (options.scale > 0) ? scaled_threshold(options.kmer_size, options.scale) : 0;
+    early_stop_tracker early_stop{.limit = (options.scale > 0) ? 0 : options.early_stop};
+
+    with_kmer_size(options.kmer_size, [&] (auto const kmer_size)
+    {
+        for (auto && rec : seqan3::sequence_file_input<my_traits>{filename})
+        {
+            workspace.bases += rec.sequence().size();
+
+            for_each_kmer_hash(rec.sequence(), kmer_size, [&] (uint64_t const hash)
+            {
+                bool changed{false};
+
+                // not sampled anyway, no need to count it (the top of a full bottom-k sketch only decreases)
+                if (options.scale > 0 ? hash <= threshold : sketch.size() < sketch_size || hash < sketch.top())
+                {
+                    if (abundances.add(hash) == options.min_abundance)
+                    {
+                        if (options.scale > 0)
+                            hashes.push_back(hash);
+                        else
+                            changed = insert_into_sketch(hash, sketch_size, sketch);
+                    }
+                }
+
+                early_stop.update(changed);
+            });
+
+            if (early_stop.stable(rec.sequence().size()))
+            {
+                early_stop.report(filename);
+                break;
+            }
+        }
+    });
+
+    if (options.scale > 0)
+    {
+        finalise_scaled_sketch(hashes);
+    }
+    else
+    {
+        hashes.assign(sketch.container().begin(), sketch.container().end());
+        std::ranges::sort(hashes);
+    }
+}
+
+// Sketches all records of `filename` into one sketch (bottom-k of `sketch_size` or scaled, depending on `options.scale`).
+// The sorted hashes are stored in `workspace.hashes`. `.sketch` files are read instead (see read_precomputed_sketch).
+inline void sketch_file(std::filesystem::path const & filename,
+                        smash_options const & options,
+                        sketch_workspace & workspace,
+                        uint32_t const sketch_size)
+{
+    std::vector<uint64_t> & hashes = workspace.hashes;
+    hashes.clear();
+    workspace.bases = 0;
+
+    if (is_sketch_file(filename))
+        return read_precomputed_sketch(filename, options, hashes, sketch_size);
+
+    if (options.min_abundance > 1)
+        return sketch_solid_kmers(filename, options, workspace, sketch_size);
+
+    with_kmer_size(options.kmer_size, [&] (auto const kmer_size)
+    {
+        if (options.scale > 0)
+        {
+            uint64_t const threshold = scaled_threshold(options.kmer_size, options.scale);
+
+            for (auto && rec : seqan3::sequence_file_input<my_traits>{filename})
+            {
+                workspace.bases += rec.sequence().size();
+                add_to_scaled_sketch(rec.sequence(), kmer_size, threshold, hashes);
+            }
+
+            finalise_scaled_sketch(hashes);
+        }
+        else
+        {
+            my_priority_queue<uint64_t> & sketch = workspace.heap;
+            sketch.clear();
+            sketch.reserve(sketch_size);
+
+            early_stop_tracker early_stop{.limit = options.early_stop};
+
+            for (auto && rec : seqan3::sequence_file_input<my_traits>{filename})
+            {
+                workspace.bases += rec.sequence().size();
+
+                if (early_stop.limit > 0)
+                {
+                    for_each_kmer_hash(rec.sequence(), kmer_size, [&] (uint64_t const hash)
+                    {
+                        early_stop.update(insert_into_sketch(hash, sketch_size, sketch));
+                    });
+
+                    if (early_stop.stable(rec.sequence().size()))
+                    {
+                        early_stop.report(filename);
+                        break;
+                    }
+                }
+                else if (sketch.size() < sketch_size) // e.g. short reads: fill the sketch over several records
+                {
+                    init_sketch(rec.sequence(), kmer_size, sketch_size, sketch);
+                }
+                else
+                {
+                    add_to_sketch(rec.sequence(), kmer_size, sketch);
+                }
+            }
+            hashes.assign(sketch.container().begin(), sketch.container().end());
+            std::ranges::sort(hashes);
+        }
+    });
+}
+
+// Sketching of sequences that arrive one at a time, e.g. the records of a sample read from a stream, like
+// sketch_file() sketches the records of a file: start_sketch(), sketch_sequence() for every record, finish_sketch().
+// Only the sketch is kept, not the sequences.
+inline void start_sketch(smash_options const & options, sketch_workspace & workspace)
+{
+    workspace.hashes.clear();
+    workspace.heap.clear();
+    workspace.heap.reserve(options.sketch_size);
+    workspace.bases = 0;
+}
+
+template <typename sequence_t>
+void sketch_sequence(sequence_t const & sequence, smash_options const & options, sketch_workspace & workspace)
+{
+    my_priority_queue<uint64_t> & sketch = workspace.heap;
+    workspace.bases += std::ranges::size(sequence);
+
+    with_kmer_size(options.kmer_size, [&] (auto const kmer_size)
+    {
+        if (options.scale > 0)
+            add_to_scaled_sketch(sequence, kmer_size, scaled_threshold(options.kmer_size, options.scale),
+                                 workspace.hashes);
+        else if (sketch.size() < options.sketch_size) // e.g. short reads: fill the sketch over several records
+            init_sketch(sequence, kmer_size, options.sketch_size, sketch);
+        else
+            add_to_sketch(sequence, kmer_size, sketch);
+    });
+}
+
+// the sorted hashes are stored in `workspace.hashes`
+inline void finish_sketch(smash_options const & options, sketch_workspace & workspace)
+{
+    if (options.scale > 0)
+    {
+        finalise_scaled_sketch(workspace.hashes);
+    }
+    else
+    {
+        workspace.hashes.assign(workspace.heap.container().begin(), workspace.heap.container().end());
+        std::ranges::sort(workspace.hashes);
+    }
+}
+
+// Sketches `filename` for all `options.kmer_sizes` in one pass over the sequences, workspaces[j] receives the sketch
+// for options.kmer_sizes[j]. Every hash is also passed to each_hash(j, hash), e.g. to count the k-mers in the same
+// pass. Filters, early termination and precomputed sketches are not supported.
+template <typename each_hash_t>
+void sketch_file_multi_k(std::filesystem::path const & filename,
+                         smash_options const & options,
+                         std::vector<sketch_workspace> & workspaces,
+                         each_hash_t && each_hash)
+{
+    size_t const number_of_kmer_sizes = options.kmer_sizes.size();
+    workspaces.resize(number_of_kmer_sizes);
+
+    std::vector<uint64_t> thresholds{};
+    for (size_t j = 0; j < number_of_kmer_sizes; ++j)
+    {
+        workspaces[j].hashes.clear();
+        workspaces[j].heap.clear();
+        workspaces[j].heap.reserve(options.sketch_size);
+        workspaces[j].bases = 0;
+        thresholds.push_back((options.scale > 0) ? scaled_threshold(options.kmer_sizes[j], options.scale) : 0);
+    }
+
+    for (auto && rec : seqan3::sequence_file_input<my_traits>{filename})
+    {
+        for (auto & workspace : workspaces)
+            workspace.bases += rec.sequence().size();
+
+        for_each_multi_kmer_hash(rec.sequence(), options.kmer_sizes, [&] (size_t const j, uint64_t const hash)
+        {
+            each_hash(j, hash);
+
+            if (options.scale == 0)
+                insert_into_sketch(hash, options.sketch_size, workspaces[j].heap);
+            else if (hash <= thresholds[j])
+                workspaces[j].hashes.push_back(hash);
+        });
+    }
+
+    for (auto & workspace : workspaces)
+    {
+        if (options.scale > 0)
+        {
+            finalise_scaled_sketch(workspace.hashes);
+        }
+        else
+        {
+            workspace.hashes.assign(workspace.heap.container().begin(), workspace.heap.container().end());
+            std::ranges::sort(workspace.hashes);
+        }
+    }
+}
+
+inline void sketch_file(std::filesystem::path const & filename,
+                        smash_options const & options,
+                        sketch_workspace & workspace)
+{
+    sketch_file(filename, options, workspace, options.sketch_size);
+}
+
+inline std::vector<uint64_t> sketch_file(std::filesystem::path const & filename, smash_options const & options)
+{
+    sketch_workspace workspace{};
+    sketch_file(filename, options, workspace);
+    return std::move(workspace.hashes);
+}
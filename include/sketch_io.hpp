@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Precomputed sketches. A file with the extension `.sketch` in an input list is read instead of hashed.
+// Layout (little endian, host byte order):
+//   char[8] magic | uint32_t version | uint32_t kmer_size | uint64_t scale | uint64_t sketch_size |
+//   uint64_t kmer_count | uint64_t #hashes | #hashes sorted uint64_t
+// scale is 0 for bottom-k sketches, sketch_size is 0 for scaled sketches.
+// kmer_count is the estimated number of distinct k-mers of the sketched file(s).
+inline constexpr char sketch_magic[8] = {'S', 'M', 'A', 'S', 'H', 'S', 'K', 'T'};
+inline constexpr uint32_t sketch_version{1};
+inline constexpr char sketch_extension[] = ".sketch";
+
+struct sketch_header
+{
+    uint32_t kmer_size{};
+    uint64_t scale{};
+    uint64_t sketch_size{};
+    uint64_t kmer_count{};
+    uint64_t number_of_hashes{};
+};
+
+inline bool is_sketch_file(std::filesystem::path const & filename)
+{
+    return filename.extension() == sketch_extension;
+}
+
+inline sketch_header read_sketch_header(std::istream & fin, std::filesystem::path const & filename)
+{
+    char magic[sizeof(sketch_magic)];
+    uint32_t version{};
+    sketch_header header{};
+
+    fin.read(magic, sizeof(magic));
+    fin.read(reinterpret_cast<char *>(&version), sizeof(version));
+
+    if (!fin || std::memcmp(magic, sketch_magic, sizeof(magic)) != 0)
+        throw std::runtime_error{filename.string() + " is not a smash sketch."};
+    if (version != sketch_version)
+        throw std::runtime_error{"Unsupported sketch version " + std::to_string(version) + " in " + filename.string()};
+
+    fin.read(reinterpret_cast<char *>(&header.kmer_size), sizeof(header.kmer_size));
+    fin.read(reinterpret_cast<char *>(&header.scale), sizeof(header.scale));
+    fin.read(reinterpret_cast<char *>(&header.sketch_size), sizeof(header.sketch_size));
+    fin.read(reinterpret_cast<char *>(&header.kmer_count), sizeof(header.kmer_count));
+    fin.read(reinterpret_cast<char *>(&header.number_of_hashes), sizeof(header.number_of_hashes));
+
+    if (!fin)
+        throw std::runtime_error{"Sketch " + filename.string() + " is truncated."};
+
+    return header;
+}
+
+inline sketch_header read_sketch_header(std::filesystem::path const & filename)
+{
+    std::ifstream fin{filename, std::ios::binary};
+    if (!fin.good())
+        throw std::runtime_error{"Could not open file " + filename.string()};
+
+    return read_sketch_header(fin, filename);
+}
+
+inline sketch_header read_sketch(std::filesystem::path const & filename, std::vector<uint64_t> & hashes)
+{
+    std::ifstream fin{filename, std::ios::binary};
+    if (!fin.good())
+        throw std::runtime_error{"Could not open file " + filename.string()};
+
+    sketch_header const header = read_sketch_header(fin, filename);
+
+    hashes.resize(header.number_of_hashes);
+    fin.read(reinterpret_cast<char *>(hashes.data()), hashes.size() * sizeof(uint64_t));
+
+    if (!fin)
+        throw std::runtime_error{"Sketch " + filename.string() + " is truncated."};
+
+    return header;
+}
+
+// `hashes` must be sorted
+inline void write_sketch(std::filesystem::path const & filename,
+                         sketch_header header,
+                         std::vector<uint64_t> const & hashes)
+{
+    std::ofstream fout{filename, std::ios::binary};
+    if (!fout.good())
+        throw std::runtime_error{"Could not open file " + filename.string()};
+
+    header.number_of_hashes = hashes.size();
+
+    fout.write(sketch_magic, sizeof(sketch_magic));
+    fout.write(reinterpret_cast<char const *>(&sketch_version), sizeof(sketch_version));
+    fout.write(reinterpret_cast<char const *>(&header.kmer_size), sizeof(header.kmer_size));
+    fout.write(reinterpret_cast<char const *>(&header.scale), sizeof(header.scale));
+    fout.write(reinterpret_cast<char const *>(&header.sketch_size), sizeof(header.sketch_size));
+    fout.write(reinterpret_cast<char const *>(&header.kmer_count), sizeof(header.kmer_count));
+    fout.write(reinterpret_cast<char const *>(&header.number_of_hashes), sizeof(header.number_of_hashes));
+    fout.write(reinterpret_cast<char const *>(hashes.data()), hashes.size() * sizeof(uint64_t));
+
+    if (!fout)
+        throw std::runtime_error{"Could not write sketch " + filename.string()};
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include "options.hpp"
+
+void stream_search(smash_options const & options);
+
+void per_record_search(smash_options const & options);
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/* Lock-free union-find for single-linkage clustering from many threads.
+ * Roots are always linked to the smaller root, so the representative of a set is its smallest element and the
+ * result does not depend on the order in which edges are added.
+ */
+class concurrent_union_find
+{
+public:
+    explicit concurrent_union_find(size_t const size) : parent(size)
+    {
+        for (size_t i = 0; i < size; ++i)
+            parent[i].store(i, std::memory_order_relaxed);
+    }
+
+    size_t size() const
+    {
+        return parent.size();
+    }
+
+    uint32_t find(uint32_t element)
+    {
+        while (true)
+        {
+            uint32_t const up = parent[element].load(std::memory_order_acquire);
+            if (up == element)
+                return element;
+
+            // path halving, losing the race only means the path is not shortened
+            uint32_t const grand_parent = parent[up].load(std::memory_order_acquire);
+            uint32_t expected = up;
+            parent[element].compare_exchange_weak(expected, grand_parent, std::memory_order_release,
+                                                  std::memory_order_relaxed);
+            element = grand_parent;
+        }
+    }
+
+    void unite(uint32_t const a, uint32_t const b)
+    {
+        while (true)
+        {
+            uint32_t root_a = find(a);
+            uint32_t root_b = find(b);
+
+            if (root_a == root_b)
+                return;
+
+            if (root_a < root_b)
+                std::swap(root_a, root_b);
+
+            // link the larger root below the smaller one, retry if root_a stopped being a root meanwhile
+            uint32_t expected = root_a;
+            if (parent[root_a].compare_exchange_strong(expected, root_b, std::memory_order_acq_rel))
+                return;
+        }
+    }
+
+private:
+    std::vector<std::atomic<uint32_t>> parent;
+};
@@ -0,0 +1,5 @@
+#pragma once
+
+#include "options.hpp"
+
+void update_matrix(smash_options const & options);
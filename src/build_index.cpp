@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+#include <chopper/layout/execute.hpp>
+#include <chopper/sketch/execute.hpp>
+#include <chopper/sketch/estimate_kmer_counts.hpp>
+#include <chopper/sketch/hyperloglog.hpp>
+
+#include <raptor/argument_parsing/build_arguments.hpp>
+#include <raptor/build/raptor_build.hpp>
+
+#include "build_index.hpp"
+#include "index_info.hpp"
+#include "options.hpp"
+#include "parallel.hpp"
+#include "sketch_file.hpp"
+
+// Writes `hashes` as a raptor minimiser file (raw uint64_t) with the accompanying header file
+// (shape, window size, cutoff, count), so the directory can also be passed to `raptor build` directly.
+void write_minimiser_file(std::filesystem::path const & filename,
+                          std::vector<uint64_t> const & hashes,
+                          uint8_t const kmer_size)
+{
+    std::ofstream fout{filename, std::ios::binary};
+    if (!fout.good())
+        throw std::runtime_error{"Could not open file " + filename.string()};
+
+    fout.write(reinterpret_cast<char const *>(hashes.data()), hashes.size() * sizeof(uint64_t));
+    if (!fout)
+        throw std::runtime_error{"Could not write " + filename.string()};
+
+    std::filesystem::path header_file{filename};
+    header_file.replace_extension(".header");
+    std::ofstream header{header_file};
+    if (!header.good())
+        throw std::runtime_error{"Could not open file " + header_file.string()};
+
+    header << std::string(kmer_size, '1') << '\t' << +kmer_size << '\t' << 0 << '\t' << hashes.size() << '\n';
+}
+
+// Builds an HIBF for the references in options.files at options.output_file, with the same hashes that search()
+// counts. With --scaled, only the hashes of the scaled sketches of the references are inserted: the index is about
+// `scale` times smaller and faster to build and load, and can be searched with the same or a larger --scaled.
+// Otherwise all hashes are inserted, like `raptor build` would.
+// The parameters and the k-mer counts of the references are written to <index>.smash, so searches do not have to
+// estimate them from the references again.
+void build_index(smash_options const & options)
+{
+    if (options.files.empty())
+        throw std::runtime_error{"No references in " + options.input_file.string()};
+    if (std::ranges::any_of(options.files, is_sketch_file))
+        throw std::runtime_error{"Please index the references, not precomputed sketches."};
+    if (options.fpr <= 0.0 || options.fpr >= 1.0)
+        throw std::runtime_error{"--fpr must be in (0, 1)."};
+
+    bool const sketch_only = options.scale > 0;
+    size_t const number_of_references = options.files.size();
+
+    index_info info{.kmer_size = options.kmer_size, .scale = options.scale, .fpr = options.fpr};
+    info.references = options.files;
+
+    chopper::configuration config{.data_file = options.input_file,
+                                  .k = options.kmer_size,
+                                  .disable_sketch_output = true,
+                                  .threads = options.threads};
+
+    // The k-mer counts of the references, which the distances are computed with. Without --scaled, these
+    // HyperLogLog sketches are also the ones of the user bins.
+    std::cerr << "Estimating k-mer counts..." << std::endl;
+    std::vector<chopper::sketch::hyperloglog> sketches{};
+    {
+        chopper::sketch::execute(config, options.files, sketches);
+        std::vector<size_t> kmer_counts{};
+        chopper::sketch::estimate_kmer_counts(sketches, kmer_counts);
+        info.sizes.assign(kmer_counts.begin(), kmer_counts.end());
+    }
+
+    if (sketch_only)
+    {
+        std::filesystem::path const hash_directory{options.output_file.string() + "_hashes"};
+        std::filesystem::create_directories(hash_directory);
+
+        info.bin_paths.resize(number_of_references);
+
+        std::cerr << "Sketching references..." << std::endl;
+        auto worker = [&] (chunk_queue & chunks)
+        {
+            sketch_workspace workspace{};
+
+            size_t start{};
+            size_t end{};
+            while (chunks.pop(start, end))
+            {
+                for (size_t i = start; i < end; ++i)
+                {
+                    std::filesystem::path const reference{options.files[i]};
+                    sketch_file(reference, options, workspace);
+
+                    // the number makes the names unique when references in different directories share a name
+                    std::filesystem::path const bin_path =
+                        hash_directory / (std::to_string(i) + '_' + reference.filename().string() + ".minimiser");
+                    write_minimiser_file(bin_path, workspace.hashes, options.kmer_size);
+
+                    chopper::sketch::hyperloglog sketch{config.sketch_bits};
+                    for (uint64_t const hash : workspace.hashes)
+                        sketch.add(reinterpret_cast<char const *>(&hash), sizeof(hash));
+
+                    sketches[i] = std::move(sketch);
+                    info.bin_paths[i] = bin_path.string();
+                }
+            }
+        };
+
+        do_parallel_dynamic(worker, number_of_references, options.threads, 1);
+    }
+    else
+    {
+        info.bin_paths = options.files;
+    }
+
+    std::cerr << "Computing the layout..." << std::endl;
+    std::filesystem::path const layout_file{options.output_file.string() + ".layout"};
+    config.output_filename = layout_file;
+    config.false_positive_rate = options.fpr;
+    chopper::layout::execute(config, info.bin_paths, sketches);
+
+    std::cerr << "Building the index..." << std::endl;
+    raptor::build_arguments arguments{};
+    arguments.kmer_size = options.kmer_size;
+    arguments.window_size = options.kmer_size;
+    arguments.shape = seqan3::shape{seqan3::ungapped{options.kmer_size}};
+    arguments.fpr = options.fpr;
+    arguments.threads = options.threads;
+    arguments.is_hibf = true;
+    arguments.input_is_minimiser = sketch_only;
+    arguments.bin_file = layout_file;
+    arguments.out_path = options.output_file;
+    for (auto const & bin_path : info.bin_paths)
+        arguments.bin_path.push_back({bin_path});
+
+    raptor::raptor_build(arguments);
+
+    write_index_info(options.output_file, info);
+}
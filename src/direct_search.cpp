@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <span>
+
+#include <raptor/search/do_parallel.hpp>
+
+#include "checkpoint.hpp"
+#include "direct_search.hpp"
+#include "metrics.hpp"
+#include "options.hpp"
+#include "parallel.hpp"
+#include "sketch_file.hpp"
+
+// All sketches of a collection in one contiguous vector, sketch i is hashes[offsets[i]] ... hashes[offsets[i + 1] - 1].
+struct flat_sketches
+{
+    std::vector<uint64_t> hashes{};
+    std::vector<size_t> offsets{0};
+
+    size_t size() const { return offsets.size() - 1; }
+
+    std::span<uint64_t const> operator[](size_t const i) const
+    {
+        return {hashes.data() + offsets[i], hashes.data() + offsets[i + 1]};
+    }
+};
+
+flat_sketches sketch_files(std::vector<std::string> const & filenames, smash_options const & options)
+{
+    std::vector<std::vector<uint64_t>> sketches(filenames.size());
+
+    auto worker = [&](size_t const start, size_t const end)
+    {
+        sketch_workspace workspace{};
+        for (size_t i = start; i < end; ++i)
+        {
+            sketch_file(filenames[i], options, workspace);
+            sketches[i] = workspace.hashes;
+
+            // a precomputed sketch may repeat a hash, sketch_jaccard() counts every hash once
+            auto const [first, last] = std::ranges::unique(sketches[i]);
+            sketches[i].erase(first, last);
+        }
+    };
+
+    raptor::do_parallel(worker, filenames.size(), options.threads);
+
+    flat_sketches result{};
+    size_t total_size{0};
+    for (auto const & sketch : sketches)
+        total_size += sketch.size();
+
+    result.hashes.reserve(total_size);
+    result.offsets.reserve(sketches.size() + 1);
+    for (auto & sketch : sketches)
+    {
+        result.hashes.insert(result.hashes.end(), sketch.begin(), sketch.end());
+        result.offsets.push_back(result.hashes.size());
+        std::vector<uint64_t>{}.swap(sketch);
+    }
+
+    return result;
+}
+
+/* Jaccard estimate of two sorted sketches without duplicates.
+ * Bottom-k (Mash): the fraction of the bottom-`sketch_size` hashes of the union that are in both sketches.
+ * Scaled (sketch_size == 0): |A ∩ B| / |A ∪ B| over all sampled hashes.
+ * The merge loop is branchless apart from the loop condition.
+ */
+double sketch_jaccard(std::span<uint64_t const> a, std::span<uint64_t const> b, uint64_t const sketch_size)
+{
+    uint64_t const limit = (sketch_size == 0) ? std::numeric_limits<uint64_t>::max() : sketch_size;
+
+    size_t i{0};
+    size_t j{0};
+    uint64_t shared{0};
+    uint64_t union_size{0};
+
+    while (i < a.size() && j < b.size() && union_size < limit)
+    {
+        uint64_t const x = a[i];
+        uint64_t const y = b[j];
+        shared += (x == y);
+        i += (x <= y);
+        j += (y <= x);
+        ++union_size;
+    }
+
+    // whatever is left of the longer sketch only contributes to the union
+    union_size += std::min<uint64_t>(limit - union_size, (a.size() - i) + (b.size() - j));
+
+    return (union_size == 0) ? 0.0 : static_cast<double>(shared) / static_cast<double>(union_size);
+}
+
+// Compares query and reference sketches directly, without an index.
+// The output has the same format as `search()`.
+void direct_search(smash_options const & options)
+{
+    std::cerr << "Sketching references..." << std::endl;
+    flat_sketches const references = sketch_files(options.references, options);
+
+    // Tiles of references whose hashes fit into the L2 cache together.
+    size_t constexpr tile_bytes{1ULL << 19};
+    size_t constexpr query_block_size{64};
+
+    std::vector<size_t> tiles{0};
+    for (size_t r = 0, bytes = 0; r < references.size(); ++r)
+    {
+        bytes += references[r].size() * sizeof(uint64_t);
+        if (bytes >= tile_bytes)
+        {
+            tiles.push_back(r + 1);
+            bytes = 0;
+        }
+    }
+    if (tiles.back() != references.size())
+        tiles.push_back(references.size());
+
+    checkpointed_out synced_out{options.output_file,
+                                std::chrono::seconds{options.checkpoint_interval},
+                                options.resume,
+                                options.ordered,
+                                options.threads * query_block_size * 4};
+
+    if (!synced_out.is_resumed()) // write header line
+    {
+        std::string line{"#filenames"};
+        for (auto const & filename : options.references)
+        {
+            line += '\t';
+            line += filename;
+            line += ';';
+        }
+        line += '\n';
+        synced_out.write(line);
+    }
+
+    std::vector<std::string> queries{};
+    for (auto const & filename : options.files)
+        if (synced_out.completed_queries().count(filename) == 0)
+            queries.push_back(filename);
+
+    std::cerr << "Sketching queries..." << std::endl;
+    flat_sketches const query_sketches = sketch_files(queries, options);
+
+    std::cerr << "Computing distances..." << std::endl;
+    uint64_t const sketch_size = (options.scale > 0) ? 0 : options.sketch_size;
+
+    // the queries are sketched before, a row only compares sketches
+    job_metrics metrics{options.metrics_file,
+                        options.progress,
+                        std::chrono::seconds{options.metrics_interval},
+                        queries.size()};
+    metrics.add_gauge("smash_output_queue_rows", "Rows waiting to be written.",
+                      [&] () { return synced_out.queued_rows(); });
+
+    auto worker = [&](chunk_queue & chunks)
+    {
+        thread_counters & thread_metrics = metrics.register_thread();
+        std::vector<double> block(query_block_size * references.size());
+        std::string result_string{};
+        result_string.reserve(4096 + references.size() * 16);
+
+        size_t block_start{};
+        size_t block_end{};
+        while (chunks.pop(block_start, block_end))
+        {
+            auto block_time = std::chrono::steady_clock::now();
+
+            for (size_t t = 0; t + 1 < tiles.size(); ++t)
+                for (size_t q = block_start; q < block_end; ++q)
+                    for (size_t r = tiles[t]; r < tiles[t + 1]; ++r)
+                        block[(q - block_start) * references.size() + r] =
+                            sketch_jaccard(query_sketches[q], references[r], sketch_size);
+
+            for (size_t q = block_start; q < block_end; ++q)
+            {
+                result_string.clear();
+                result_string += queries[q];
+
+                for (size_t r = 0; r < references.size(); ++r)
+                {
+                    result_string += '\t';
+                    result_string += std::to_string(block[(q - block_start) * references.size() + r]);
+                }
+
+                result_string += '\n';
+                synced_out.write(result_string, queries[q], q);
+
+                // the first query of a block carries the time of the whole block
+                thread_metrics.query_done(0, 0, block_time);
+                block_time = std::chrono::steady_clock::now();
+            }
+        }
+    };
+
+    do_parallel_dynamic(worker, queries.size(), options.threads, query_block_size, [&] () { synced_out.abort(); });
+    synced_out.close();
+}
@@ -6,75 +6,133 @@
 #include <raptor/dna4_traits.hpp>
 #include <raptor/search/do_parallel.hpp>
 #include <raptor/search/load_index.hpp>
-#include <raptor/search/sync_out.hpp>
 #include <raptor/adjust_seed.hpp>
 
-#include <robin_hood.h>
-
+#include "checkpoint.hpp"
+#include "index_info.hpp"
 #include "jaqquard_dist.hpp"
+#include "metrics.hpp"
 #include "options.hpp"
+#include "parallel.hpp"
+#include "radix_sort.hpp"
+#include "sketch.hpp"
 
 struct my_traits : seqan3::sequence_file_input_default_traits_dna
 {
     using sequence_alphabet = seqan3::dna4; // instead of dna5
 };
 
-std::vector<uint64_t> compute_sizes(std::vector<std::string> const & filenames,
-                                    smash_options const & options)
+// every k-mer occurrence is collected (8 bytes) and sorted with a scratch buffer of the same size (8 bytes)
+size_t constexpr bytes_per_exact_hash{16};
+
+// The number of distinct k-mers of a file is bounded by its number of bases, which is estimated from the file size.
+size_t number_of_partitions(std::filesystem::path const & filename, smash_options const & options)
+{
+    if (options.memory_budget == 0)
+        return 1;
+
+    auto const extension = filename.extension();
+    bool const compressed = (extension == ".gz" || extension == ".bgzf" || extension == ".bz2");
+
+    uint64_t const estimated_kmers = std::filesystem::file_size(filename) * (compressed ? 4 : 1);
+    uint64_t const budget_per_thread = (options.memory_budget << 20) / std::max<size_t>(options.threads, 1);
+    uint64_t const needed = estimated_kmers * bytes_per_exact_hash;
+
+    return std::max<uint64_t>(1, (needed + budget_per_thread - 1) / std::max<uint64_t>(budget_per_thread, 1));
+}
+
+// Hashes are not uniformly distributed (they are k-mer ranks XOR seed), so they are mixed before partitioning.
+// The partition is taken from the high bits of the mixed value, which depend on all bits of the hash, by scaling it to
+// [0, partitions). The low bits, e.g. `% partitions` for a power of two, only depend on the low bits of the hash.
+__extension__ typedef unsigned __int128 uint128_t; // no warning with -pedantic
+
+inline size_t partition_of(uint64_t const hash, size_t const partitions)
 {
-    std::vector<uint64_t> sizes{};
-    robin_hood::unordered_set<uint64_t> hashes{};
+    uint64_t const mixed = hash * 0x9E3779B97F4A7C15ULL;
+    return static_cast<size_t>((static_cast<uint128_t>(mixed) * partitions) >> 64);
+}
 
-    auto get_kmers = seqan3::views::minimiser_hash(seqan3::shape{seqan3::ungapped{options.kmer_size}},
-                                                   seqan3::window_size{options.kmer_size},
-                                                   seqan3::seed{raptor::adjust_seed(options.kmer_size)});
+// Collects the hashes of `filename` that fall into `partition` of `partitions` as sorted, unique values.
+// Collecting into a flat vector and radix sorting it is much more cache friendly than inserting into a hash set.
+void collect_exact_hashes(std::filesystem::path const & filename,
+                          smash_options const & options,
+                          size_t const partition,
+                          size_t const partitions,
+                          std::vector<uint64_t> & hashes,
+                          std::vector<uint64_t> & buffer)
+{
+    hashes.clear();
 
-    for (auto const & filename : filenames)
+    with_kmer_size(options.kmer_size, [&] (auto const kmer_size)
     {
-        hashes.clear();
         for (auto && rec : seqan3::sequence_file_input<my_traits>{filename})
-            for (auto const hash : rec.sequence() | get_kmers)
-                hashes.insert(hash);
+            for_each_kmer_hash(rec.sequence(), kmer_size, [&] (uint64_t const hash)
+            {
+                if (partitions == 1 || partition_of(hash, partitions) == partition)
+                    hashes.push_back(hash);
+            });
+    });
 
-        sizes.push_back(hashes.size());
-        return sizes;
-    }
+    radix_sort_unique(hashes, buffer);
+}
+
+std::vector<uint64_t> compute_sizes(std::vector<std::string> const & filenames,
+                                    smash_options const & options)
+{
+    std::vector<uint64_t> sizes(filenames.size());
+
+    auto worker = [&](size_t const start, size_t const end)
+    {
+        std::vector<uint64_t> hashes{};
+        std::vector<uint64_t> buffer{};
+
+        for (size_t i = start; i < end; ++i)
+        {
+            // the partitions are disjoint, their sizes add up (see the query loop below)
+            size_t const partitions = number_of_partitions(filenames[i], options);
+            for (size_t partition = 0; partition < partitions; ++partition)
+            {
+                collect_exact_hashes(filenames[i], options, partition, partitions, hashes, buffer);
+                sizes[i] += hashes.size();
+            }
+        }
+    };
+
+    raptor::do_parallel(worker, filenames.size(), options.threads);
 
     return sizes;
 }
 
-std::vector<std::string> get_index_filenames(raptor::raptor_index<raptor::index_structure::hibf> const & index)
+std::vector<std::string> get_index_filenames(raptor::raptor_index<raptor::index_structure::hibf> const & index,
+                                             std::optional<index_info> const & info)
 {
-    std::vector<std::string> filenames;
-    for (auto const & user_bin_paths : index.bin_path())
-    {
-        if (user_bin_paths.size() != 1)
-            throw std::runtime_error{"No multi file user bins allowed yet;"};
-        filenames.push_back(user_bin_paths.front());
-    }
-    return filenames;
+    return bin_references(index.bin_path(), info);
 }
 
 void jaqquard_dist(smash_options const & options)
 {
     auto index = raptor::raptor_index<raptor::index_structure::hibf>{};
 
-    auto get_kmers = seqan3::views::minimiser_hash(seqan3::shape{seqan3::ungapped{options.kmer_size}},
-                                                   seqan3::window_size{options.kmer_size},
-                                                   seqan3::seed{raptor::adjust_seed(options.kmer_size)});
-
     raptor::search_arguments arguments{.index_file = options.index_file,
                                        .out_file = options.output_file};
 
     load_index(index, arguments);
 
-    std::vector<std::string> const index_filenames = get_index_filenames(index);
+    // The exact distances count every k-mer of the query in the index and read the references to size the user bins.
+    std::optional<index_info> const info = read_index_info(options.index_file);
+    if (info && info->scale > 0)
+        throw std::runtime_error{"The index " + options.index_file.string() + " only holds the hashes of --scaled " +
+                                 std::to_string(info->scale) + " sketches. --disable-sketching needs an index of "
+                                 "all k-mers."};
+
+    std::vector<std::string> const index_filenames = get_index_filenames(index, info);
 
     std::cerr << "Computing index user bin sizes..." << std::endl;
     std::vector<uint64_t> const index_filename_sizes = compute_sizes(index_filenames, options);
 
     // raptor::sync_out synced_out_mash{options.output_file.string() + ".mash"};
-    raptor::sync_out synced_out{arguments};
+    checkpointed_out synced_out{options.output_file, std::chrono::seconds{0}, false, options.ordered,
+                                options.threads * 16u};
 
     std::cerr << "Writing header line..." << std::endl;
     { // write header line
@@ -90,47 +148,83 @@ void jaqquard_dist(smash_options const & options)
 
     std::cerr << "Computing distances..." << std::endl;
 
-    // auto worker = [&](size_t const start, size_t const end)
-    // {
+    size_t const number_of_bins = index_filenames.size();
+
+    job_metrics metrics{options.metrics_file,
+                        options.progress,
+                        std::chrono::seconds{options.metrics_interval},
+                        options.files.size()};
+    metrics.add_gauge("smash_output_queue_rows", "Rows waiting to be written.",
+                      [&] () { return synced_out.queued_rows(); });
+
+    auto worker = [&](chunk_queue & chunks)
+    {
         auto counter = index.template counting_agent<uint32_t>();
+        thread_counters & thread_metrics = metrics.register_thread();
 
         std::string result_string{};
+        result_string.reserve(4096 + number_of_bins * 16);
+
+        // cleared instead of reallocated for every file, they keep the capacity of the largest partition seen so far
+        std::vector<uint64_t> hashes{};
+        std::vector<uint64_t> buffer{};
+        std::vector<uint64_t> counts(number_of_bins);
 
-        for (auto const & filename : options.files /* | seqan3::views::slice(start, end) */)
+        size_t start{};
+        size_t end{};
+        while (chunks.pop(start, end))
         {
-            result_string.clear();
-            result_string += filename;
+            for (size_t q = start; q < end; ++q)
+            {
+                auto const & filename = options.files[q];
+                auto const query_start = std::chrono::steady_clock::now();
 
-            robin_hood::unordered_set<uint64_t> hashes{};
+                result_string.clear();
+                result_string += filename;
 
-            for (auto && rec : seqan3::sequence_file_input<my_traits>{filename})
-                for (auto const hash : rec.sequence() | get_kmers)
-                    hashes.insert(hash);
+                std::ranges::fill(counts, 0);
+                uint64_t query_size{0};
 
-            // For all hashes computed for current `filename` count their occurence for each user bin in the HIBF
-            auto & result = counter.bulk_count(hashes);
+                // With a memory budget, the hash space is split into `partitions` parts and the query is read once
+                // per part. Every part is counted against the index separately, since the parts are disjoint the
+                // counts add up.
+                size_t const partitions = number_of_partitions(filename, options);
 
-            for (size_t i = 0; i < result.size(); ++i)
-            {
-                /* A intersect B    =                  result[i]               // #shared-hashes
-                 * -------------    =   ------------------------------------
-                 *   A union B      =   index_filename_sizes[i] + hashes.size() - result[i]  // #hashes-A + #hashes-B - #shared-hashes
-                 */
+                for (size_t partition = 0; partition < partitions; ++partition)
+                {
+                    collect_exact_hashes(filename, options, partition, partitions, hashes, buffer);
 
-                auto const dist = static_cast<double>(result[i]) / (index_filename_sizes[i] + hashes.size() - result[i]) - options.fpr;
+                    // For all hashes computed for current `filename` count their occurence for each user bin in the HIBF
+                    auto & result = counter.bulk_count(hashes);
 
-                result_string += '\t';
-                result_string += std::to_string(dist);
+                    for (size_t i = 0; i < number_of_bins; ++i)
+                        counts[i] += result[i];
 
-                // synced_out_mash.write(filename + "\t" + index.bin_path()[i][0] + "\t" +
-                //                       std::to_string(result[i]) + "/" + std::to_string(hashes.size()) + "\t" +
-                //                       std::to_string(result[i]) + "/" + std::to_string(index_filename_sizes[i]) + "\n");
-            }
+                    query_size += hashes.size();
+                }
 
-            result_string += '\n';
-            synced_out.write(result_string);
+                for (size_t i = 0; i < number_of_bins; ++i)
+                {
+                    /* A intersect B    =                  counts[i]               // #shared-hashes
+                     * -------------    =   ------------------------------------
+                     *   A union B      =   index_filename_sizes[i] + query_size - counts[i]  // #hashes-A + #hashes-B - #shared-hashes
+                     */
+
+                    auto const dist = static_cast<double>(counts[i]) / (index_filename_sizes[i] + query_size - counts[i]) - options.fpr;
+
+                    result_string += '\t';
+                    result_string += std::to_string(dist);
+                }
+
+                result_string += '\n';
+                synced_out.write(result_string, filename, q);
+
+                // every distinct k-mer of the query was counted
+                thread_metrics.query_done(0, query_size, query_start);
+            }
         }
-    // };
+    };
 
-    // raptor::do_parallel(worker, options.files.size(), options.threads);
+    do_parallel_dynamic(worker, options.files.size(), options.threads, 1, [&] () { synced_out.abort(); });
+    synced_out.close();
 }
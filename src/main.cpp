@@ -1,9 +1,21 @@
+#include <algorithm>
+#include <limits>
 #include <sstream>
+#include <string_view>
 
 #include <seqan3/argument_parser/all.hpp>
 
+#include "build_index.hpp"
 #include "search.hpp"
+#include "direct_search.hpp"
 #include "jaqquard_dist.hpp"
+#include "multi_k_search.hpp"
+#include "search_hll.hpp"
+#include "shard.hpp"
+#include "shard_search.hpp"
+#include "sketch_io.hpp"
+#include "stream_search.hpp"
+#include "update_matrix.hpp"
 
 int parse_command_line(smash_options & options, int const argc, char const * const * argv)
 {
@@ -12,18 +24,109 @@ int parse_command_line(smash_options & options, int const argc, char const * con
     // Parser
     parser.info.author = "SeqAn-Team"; // give parser some infos
     parser.info.version = "1.0.0";
-    parser.add_option(options.input_file, 'i', "input", "Please provide a file with one line one file each.");
+    parser.add_option(options.input_file, 'i', "input", "Please provide a file with one line one file each. "
+                      "Files ending in .sketch are precomputed sketches (see write_sketches).");
     parser.add_option(options.index_file, 'x', "index", "Please provide an index file.");
     parser.add_option(options.output_file, 'o', "output", "The file for the distances matrix");
     parser.add_option(options.kmer_size, 'k', "kemr-size", "The kmer size.");
-    parser.add_option(options.sketch_size, 's', "sketch-size", "The sketch size.");
+    parser.add_option(options.sketch_size, 's', "sketch-size", "The sketch size.", seqan3::option_spec::standard,
+                      seqan3::arithmetic_range_validator{1, std::numeric_limits<uint32_t>::max()});
+    parser.add_option(options.sketch_error, '\0', "adaptive-error", "Choose the sketch size of each query from its "
+                      "estimated number of k-mers such that the standard error of the containment estimate is at "
+                      "most this value. 0 uses --sketch-size for all queries.");
+    parser.add_option(options.min_sketch_size, '\0', "min-sketch-size", "Lower bound for --adaptive-error.",
+                      seqan3::option_spec::advanced,
+                      seqan3::arithmetic_range_validator{1, std::numeric_limits<uint32_t>::max()});
+    parser.add_option(options.max_sketch_size, '\0', "max-sketch-size", "Upper bound for --adaptive-error, at "
+                      "least --min-sketch-size.", seqan3::option_spec::advanced,
+                      seqan3::arithmetic_range_validator{1, std::numeric_limits<uint32_t>::max()});
+    parser.add_option(options.scale, '\0', "scaled", "Use a FracMinHash sketch keeping all hashes below "
+                      "max_hash / scaled instead of a fixed size sketch. 0 disables scaled sketching.");
+    parser.add_option(options.stream, '\0', "stream", "Read FASTA/FASTQ records from this file or named pipe ('-' "
+                      "for standard input) instead of --input. The records are grouped into samples and the row of a "
+                      "sample is written as soon as it is searched.");
+    parser.add_option(options.stream_group, '\0', "stream-group", "How --stream records are grouped into samples: "
+                      "every --stream-records records, consecutive records whose ids share the prefix up to "
+                      "--stream-separator, or every record on its own.", seqan3::option_spec::standard,
+                      seqan3::value_list_validator{"records", "prefix", "record"});
+    parser.add_option(options.stream_records, '\0', "stream-records", "The number of records per sample for "
+                      "--stream-group records.");
+    parser.add_option(options.stream_separator, '\0', "stream-separator", "The end of the sample name in the record "
+                      "ids for --stream-group prefix.");
+    parser.add_option(options.kmer_sizes, '\0', "kmer-sizes", "Search several k-mer sizes in one pass over the "
+                      "queries (repeat the option), each in the index given by the --indexes at the same position. "
+                      "The matrix for k is written to <output>.k<k>.");
+    parser.add_option(options.index_files, '\0', "indexes", "The indexes for --kmer-sizes. Without --kmer-sizes: "
+                      "indexes over disjoint sets of references (repeat the option) to search instead of --index. "
+                      "Every query is sketched once and gets one row with the columns of all indexes.");
+    parser.add_option(options.index_memory, '\0', "index-memory", "Memory budget in MiB for the --indexes without "
+                      "--kmer-sizes. The indexes are loaded in groups that fit and the sketches of the queries are "
+                      "kept on disk next to the output between the groups. 0 loads all indexes at once.",
+                      seqan3::option_spec::advanced);
+    parser.add_option(options.min_abundance, '\0', "min-abundance", "For raw reads: only sketch k-mers that occur "
+                      "at least this often in a query, which removes most k-mers with sequencing errors. 1 disables "
+                      "the filter.", seqan3::option_spec::standard, seqan3::arithmetic_range_validator{1, 254});
+    parser.add_option(options.abundance_memory, '\0', "abundance-memory", "Memory in MiB per thread for counting "
+                      "the k-mers of --min-abundance.", seqan3::option_spec::advanced);
+    parser.add_option(options.early_stop, '\0', "early-stop", "Stop reading a query once this many consecutive "
+                      "k-mers did not change its sketch, e.g. for deep read sets. Ignored with --scaled. 0 reads the "
+                      "whole query.");
     parser.add_option(options.threads, 't', "threads", "The number of threads to use.");
     parser.add_option(options.fpr, '\0', "fpr", "The fpr used when building the index.", seqan3::option_spec::required);
+    parser.add_option(options.cluster_threshold, '\0', "cluster-threshold", "Instead of the matrix, write a "
+                      "single-linkage clustering of all files, linking every query to each user bin with a Jaccard "
+                      "index of at least this value. 0 writes the matrix.");
     parser.add_flag(options.no_sketching, 'd', "disable-sketching", "this will compute the true jaqquard distance.");
+    parser.add_option(options.reference_file, '\0', "references", "A file with one reference file per line. The "
+                      "query sketches are compared to the reference sketches directly instead of searching an index.");
+    parser.add_flag(options.hll, '\0', "hll", "Approximate all-vs-all matrix of the input files from HyperLogLog "
+                    "sketches. No index is needed.");
+    parser.add_option(options.hll_bits, '\0', "hll-bits", "The number of bits used for HyperLogLog registers "
+                      "(--hll uses 2^bits bytes per file, --kmer-sizes counts the k-mers of the queries with them).",
+                      seqan3::option_spec::advanced, seqan3::arithmetic_range_validator{5, 16});
+    parser.add_option(options.numa, '\0', "numa", "Placement of the index on NUMA machines: interleave its pages "
+                      "across all nodes or keep one replica per node. replicate implies --pin-threads.",
+                      seqan3::option_spec::advanced,
+                      seqan3::value_list_validator{"none", "interleave", "replicate"});
+    parser.add_flag(options.pin_threads, '\0', "pin-threads", "Pin the search threads to cores, distributed "
+                    "round-robin over the NUMA nodes.", seqan3::option_spec::advanced);
+    parser.add_flag(options.ordered, '\0', "ordered", "Write the rows in the order of --input instead of the order "
+                    "in which they are finished, e.g. to compare the results of two runs.");
+    parser.add_option(options.shard, '\0', "shard", "Only search shard --shard (0-based) of --shards of the "
+                      "queries, e.g. one per job of a job array. Merge the outputs with merge_shards.");
+    parser.add_option(options.shards, '\0', "shards", "The number of shards the queries are split into.");
+    parser.add_option(options.shard_by, '\0', "shard-by", "Split the queries into contiguous blocks of the same "
+                      "number of queries, or into shards of about the same total file size.",
+                      seqan3::option_spec::standard, seqan3::value_list_validator{"index", "size"});
+    parser.add_flag(options.per_record, '\0', "per-record", "Search every record of the --input files as a query of "
+                    "its own, e.g. the contigs of an assembly. The rows are named <file>:<record id>.");
+    parser.add_option(options.metrics_file, '\0', "metrics", "Rewrite this file every --metrics-interval seconds "
+                      "with progress, throughput, queue depths, thread utilisation and memory in the Prometheus text "
+                      "format, e.g. for the node_exporter textfile collector. --update reports each of its two searches on "
+                      "its own.");
+    parser.add_flag(options.progress, '\0', "progress", "Print progress, throughput and ETA to stderr every "
+                    "--metrics-interval seconds.");
+    parser.add_option(options.metrics_interval, '\0', "metrics-interval", "Seconds between --metrics and "
+                      "--progress reports.", seqan3::option_spec::advanced);
+    parser.add_option(options.checkpoint_interval, '\0', "checkpoint-interval", "Every this many seconds, flush the "
+                      "output and record the finished queries in <output>.checkpoint. 0 disables checkpoints.");
+    parser.add_flag(options.resume, '\0', "resume", "Skip the queries recorded in <output>.checkpoint and append to "
+                      "the existing output.");
+    parser.add_option(options.memory_budget, '\0', "memory-budget", "Memory budget in MiB for the k-mer sets of "
+                      "--disable-sketching, shared by all threads. Larger queries are processed in several passes over "
+                      "disjoint parts of the hash space. 0 means unlimited.");
+    parser.add_option(options.matrix_file, '\0', "update", "An existing matrix (text or binary) to extend with new "
+                      "queries (--input) and/or new references (--index). Only the new cells are computed.");
+    parser.add_option(options.base_index_file, '\0', "base-index", "The index the --update matrix was computed "
+                      "with. Required if --input contains queries that are not rows of the matrix yet.");
+    parser.add_flag(options.binary_output, '\0', "binary", "Write the --update matrix in binary format.");
 
     try
     {
         parser.parse();                                                  // trigger command line parsing
+
+        if (options.min_sketch_size > options.max_sketch_size)
+            throw seqan3::argument_parser_error{"--min-sketch-size must not be larger than --max-sketch-size."};
     }
     catch (seqan3::argument_parser_error const & ext)                     // catch user errors
     {
@@ -34,6 +137,41 @@ int parse_command_line(smash_options & options, int const argc, char const * con
     return 0;
 }
 
+// smash index: build an index that search() can use instead of one built by raptor
+int parse_index_command_line(smash_options & options, int const argc, char const * const * argv)
+{
+    seqan3::argument_parser parser{"smash-index", argc, argv};
+
+    options.fpr = 0.05;
+
+    parser.info.author = "SeqAn-Team";
+    parser.info.version = "1.0.0";
+    parser.info.short_description = "Builds an HIBF over the hashes that smash searches.";
+    parser.add_option(options.input_file, 'i', "input", "Please provide a file with one reference file per line.");
+    parser.add_option(options.output_file, 'o', "output", "The index file. The parameters and reference sizes are "
+                      "written to <output>.smash, the layout to <output>.layout.");
+    parser.add_option(options.kmer_size, 'k', "kmer-size", "The kmer size.");
+    parser.add_option(options.scale, '\0', "scaled", "Only index the hashes of FracMinHash sketches with this scale, "
+                      "written to <output>_hashes. The index must be searched with the same or a larger --scaled. "
+                      "0 indexes all hashes.");
+    parser.add_option(options.fpr, '\0', "fpr", "The false positive rate of the index. Searches correct for it, so "
+                      "sketch queries tolerate a higher rate than read mapping.",
+                      seqan3::option_spec::standard, seqan3::arithmetic_range_validator{0.0, 1.0});
+    parser.add_option(options.threads, 't', "threads", "The number of threads to use.");
+
+    try
+    {
+        parser.parse();
+    }
+    catch (seqan3::argument_parser_error const & ext)
+    {
+        std::cerr << "Parsing error. " << ext.what() << "\n";
+        return -1;
+    }
+
+    return 0;
+}
+
 inline auto read_input_file(std::string const & filename,
                             std::vector<std::string> & files)
 {
@@ -64,11 +202,80 @@ inline auto read_input_file(std::string const & filename,
 int main(int argc, char ** argv)
 {
     smash_options options{};
-    parse_command_line(options, argc, argv);
+
+    if (argc > 1 && std::string_view{argv[1]} == "index")
+    {
+        if (parse_index_command_line(options, argc - 1, argv + 1) != 0)
+            return -1;
+
+        read_input_file(options.input_file, options.files);
+        build_index(options);
+        return 0;
+    }
+
+    if (parse_command_line(options, argc, argv) != 0)
+        return -1;
+
+    if (options.shards == 0 || options.shard >= options.shards)
+        throw std::runtime_error{"--shard must be smaller than --shards."};
+
+    if (!options.stream.empty())
+    {
+        if (options.shards > 1) // the number of samples is only known at the end of the stream
+            throw std::runtime_error{"--shards is not supported for --stream."};
+
+        stream_search(options);
+        return 0;
+    }
 
     read_input_file(options.input_file, options.files);
+    if (!options.reference_file.empty())
+        read_input_file(options.reference_file, options.references);
+
+    if (options.shards > 1)
+    {
+        // --hll compares the queries with each other, a shard would only compare its own queries
+        if (options.cluster_threshold > 0.0 || !options.matrix_file.empty() || options.hll)
+            throw std::runtime_error{"--shards is not supported for --cluster-threshold, --update and --hll."};
+
+        options.files = select_shard(options.files, options.shard, options.shards, options.shard_by);
+        std::cerr << "Shard " << options.shard << " of " << options.shards << ": " << options.files.size()
+                  << " queries." << std::endl;
+    }
+
+    if (options.per_record && (!options.matrix_file.empty() || !options.references.empty() || options.hll ||
+        options.no_sketching))
+        throw std::runtime_error{"--per-record is only supported when searching an index."};
+
+    if (!options.index_files.empty() && options.kmer_sizes.empty() &&
+        (options.per_record || !options.matrix_file.empty() || !options.references.empty() || options.hll ||
+         options.no_sketching))
+        throw std::runtime_error{"Several --indexes are only supported when searching with sketches."};
+
+    if (!options.kmer_sizes.empty() &&
+        (!options.matrix_file.empty() || !options.references.empty() || options.hll || options.no_sketching))
+        throw std::runtime_error{"--kmer-sizes is only supported when searching indexes with sketches."};
+
+    if (options.cluster_threshold > 0.0 &&
+        (!options.matrix_file.empty() || !options.references.empty() || options.hll || options.no_sketching))
+        throw std::runtime_error{"--cluster-threshold is only supported when searching an index."};
+
+    if ((options.hll || options.no_sketching) && std::ranges::any_of(options.files, is_sketch_file))
+        throw std::runtime_error{"Precomputed sketches cannot be used with --hll or --disable-sketching."};
 
-    if (options.no_sketching)
+    if (options.per_record)
+        per_record_search(options);
+    else if (!options.kmer_sizes.empty())
+        search_multi_k(options);
+    else if (!options.index_files.empty())
+        search_index_shards(options);
+    else if (!options.matrix_file.empty())
+        update_matrix(options);
+    else if (!options.references.empty())
+        direct_search(options);
+    else if (options.hll)
+        search_hll(options);
+    else if (options.no_sketching)
         jaqquard_dist(options);
     else
         search(options);
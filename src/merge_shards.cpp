@@ -0,0 +1,229 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <queue>
+#include <string_view>
+
+#include <seqan3/argument_parser/all.hpp>
+
+#include <robin_hood.h>
+
+struct merge_options
+{
+    std::vector<std::string> shard_files{};
+    std::string input_file{};
+    std::string output_file{};
+};
+
+int parse_command_line(merge_options & options, int const argc, char const * const * argv)
+{
+    seqan3::argument_parser parser{"merge_shards", argc, argv};
+
+    // Parser
+    parser.info.author = "SeqAn-Team"; // give parser some infos
+    parser.info.version = "1.0.0";
+    parser.add_option(options.shard_files, 's', "shard", "The output of one shard (smash --shard/--shards). Repeat "
+                      "the option for every shard.");
+    parser.add_option(options.input_file, 'i', "input", "The --input all shards were split from. The rows are "
+                      "written in its order, which requires shards run with --ordered. Without it, the shards are "
+                      "concatenated as given.");
+    parser.add_option(options.output_file, 'o', "output", "The merged matrix.");
+
+    try
+    {
+        parser.parse();                                                  // trigger command line parsing
+    }
+    catch (seqan3::argument_parser_error const & ext)                     // catch user errors
+    {
+        std::cerr << "Parsing error. " << ext.what() << "\n"; // give error message
+        return -1;
+    }
+
+    return 0;
+}
+
+struct shard_reader
+{
+    std::string filename{};
+    std::ifstream fin{};
+    std::string row{};
+    size_t position{}; // of the query of `row` in --input
+    bool done{false};
+};
+
+// The position in --input of the query a row belongs to. Rows of --per-record are named <file>:<record id>.
+size_t query_position(std::string const & row,
+                      robin_hood::unordered_map<std::string, size_t> const & positions,
+                      std::string const & filename)
+{
+    std::string_view const name{row.data(), std::min(row.find('\t'), row.size())};
+
+    if (auto const it = positions.find(std::string{name}); it != positions.end())
+        return it->second;
+
+    for (size_t colon = name.find(':'); colon != std::string_view::npos; colon = name.find(':', colon + 1))
+        if (auto const it = positions.find(std::string{name.substr(0, colon)}); it != positions.end())
+            return it->second;
+
+    throw std::runtime_error{"The query " + std::string{name} + " of " + filename + " is not in --input."};
+}
+
+// Writes the rows of all shards in the order of the queries in --input. Throws if a query is in no shard or in several.
+void merge_in_input_order(merge_options const & options, std::vector<shard_reader> & shards, std::ostream & fout)
+{
+    robin_hood::unordered_map<std::string, size_t> positions{};
+    std::vector<std::string> queries{};
+    {
+        std::ifstream fin{options.input_file};
+        if (!fin.good())
+            throw std::runtime_error{"Could not open file " + options.input_file};
+
+        std::string line;
+        while (std::getline(fin, line)) // the same format as smash --input
+        {
+            if (line.empty() || line[0] == '#')
+                continue;
+
+            std::string query = line.substr(0, line.find('\t'));
+            if (positions.emplace(query, queries.size()).second)
+                queries.push_back(std::move(query));
+        }
+    }
+
+    // which shard the query at a position came from, to find queries that are in several shards
+    constexpr size_t no_shard{std::numeric_limits<size_t>::max()};
+    std::vector<size_t> owner(positions.size(), no_shard);
+
+    auto advance = [&] (size_t const s)
+    {
+        shard_reader & shard = shards[s];
+        size_t const previous = shard.position;
+
+        do
+        {
+            if (!std::getline(shard.fin, shard.row))
+            {
+                shard.done = true;
+                return;
+            }
+        }
+        while (shard.row.empty());
+
+        shard.position = query_position(shard.row, positions, shard.filename);
+
+        if (shard.position < previous)
+            throw std::runtime_error{"The rows of " + shard.filename + " are not in the order of --input. Please run "
+                                     "the shards with --ordered."};
+        if (owner[shard.position] != no_shard && owner[shard.position] != s)
+            throw std::runtime_error{"The query " + queries[shard.position] + " is in " +
+                                     shards[owner[shard.position]].filename + " and " + shard.filename + "."};
+        owner[shard.position] = s;
+    };
+
+    // k-way merge by position in --input, the shards are read once
+    auto later = [&] (size_t const a, size_t const b) { return shards[a].position > shards[b].position; };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(later)> next{later};
+
+    for (size_t s = 0; s < shards.size(); ++s)
+    {
+        advance(s);
+        if (!shards[s].done)
+            next.push(s);
+    }
+
+    while (!next.empty())
+    {
+        size_t const s = next.top();
+        next.pop();
+
+        fout << shards[s].row << '\n';
+
+        advance(s);
+        if (!shards[s].done)
+            next.push(s);
+    }
+
+    size_t const missing = std::ranges::count(owner, no_shard);
+    if (missing > 0)
+    {
+        size_t const first = std::ranges::find(owner, no_shard) - owner.begin();
+        throw std::runtime_error{std::to_string(missing) + " queries of --input are in no shard, e.g. " +
+                                 queries[first] + ". Is a shard missing or incomplete?"};
+    }
+}
+
+// Merges the matrices of the shards of one search into the matrix a single run would have written. All shards must
+// have the same header, i.e. be searched in the same index, and every query of --input must be in exactly one shard.
+// The matrix is written to <output>.tmp and only renamed to --output once all checks passed.
+void merge_shards(merge_options const & options, std::filesystem::path const & temporary)
+{
+    if (options.shard_files.empty())
+        throw std::runtime_error{"Please provide at least one --shard."};
+
+    std::vector<shard_reader> shards(options.shard_files.size());
+    std::string header{};
+
+    for (size_t s = 0; s < shards.size(); ++s)
+    {
+        shards[s].filename = options.shard_files[s];
+        shards[s].fin.open(shards[s].filename);
+        if (!shards[s].fin.good())
+            throw std::runtime_error{"Could not open file " + shards[s].filename};
+
+        std::string line;
+        if (!std::getline(shards[s].fin, line) || line.empty() || line[0] != '#')
+            throw std::runtime_error{shards[s].filename + " has no header line."};
+
+        if (s == 0)
+            header = line;
+        else if (line != header)
+            throw std::runtime_error{"The header of " + shards[s].filename + " differs from the header of " +
+                                     shards[0].filename + ". Were all shards searched in the same index?"};
+    }
+
+    std::ofstream fout{temporary};
+    if (!fout.good())
+        throw std::runtime_error{"Could not open file " + temporary.string()};
+
+    fout << header << '\n';
+
+    if (options.input_file.empty())
+    {
+        for (auto & shard : shards)
+            while (std::getline(shard.fin, shard.row))
+                if (!shard.row.empty())
+                    fout << shard.row << '\n';
+    }
+    else
+    {
+        merge_in_input_order(options, shards, fout);
+    }
+
+    fout.close();
+    if (!fout)
+        throw std::runtime_error{"Could not write to " + temporary.string()};
+}
+
+int main(int argc, char ** argv)
+{
+    merge_options options{};
+    if (parse_command_line(options, argc, argv) != 0)
+        return -1;
+
+    std::filesystem::path const temporary{options.output_file + ".tmp"};
+
+    try
+    {
+        merge_shards(options, temporary);
+    }
+    catch (...)
+    {
+        std::filesystem::remove(temporary);
+        throw;
+    }
+
+    std::filesystem::rename(temporary, options.output_file);
+    return 0;
+}
@@ -0,0 +1,205 @@
+#include <algorithm>
+#include <iostream>
+#include <memory>
+
+#include <chopper/sketch/hyperloglog.hpp>
+#include <chopper/sketch/execute.hpp>
+#include <chopper/sketch/estimate_kmer_counts.hpp>
+
+#include <raptor/argument_parsing/search_arguments.hpp>
+#include <raptor/search/load_index.hpp>
+
+#include "checkpoint.hpp"
+#include "compute_distance.hpp"
+#include "index_info.hpp"
+#include "metrics.hpp"
+#include "multi_k_search.hpp"
+#include "options.hpp"
+#include "parallel.hpp"
+#include "sketch_file.hpp"
+
+// The sizes of the user bins of `index`: recorded by `smash index`, or estimated with HyperLogLog for the k-mer size
+// of the index.
+std::vector<uint64_t> user_bin_sizes(raptor::raptor_index<raptor::index_structure::hibf> const & index,
+                                     std::filesystem::path const & index_file,
+                                     uint8_t const kmer_size,
+                                     smash_options const & options)
+{
+    std::vector<std::string> files{};
+    for (auto const & filenames : index.bin_path())
+    {
+        if (filenames.size() > 1)
+            throw std::runtime_error{"Multi file user bins not supported yet."};
+        files.push_back(filenames[0]);
+    }
+
+    if (std::optional<index_info> const info = read_index_info(index_file); info)
+    {
+        check_index_info(*info, index_file, kmer_size, options);
+
+        robin_hood::unordered_map<std::string, uint64_t> sizes{};
+        for (size_t i = 0; i < info->bin_paths.size(); ++i)
+            sizes.emplace(info->bin_paths[i], info->sizes[i]);
+
+        std::vector<uint64_t> bin_sizes{};
+        for (auto const & filename : files)
+        {
+            auto const it = sizes.find(filename);
+            if (it == sizes.end())
+                throw std::runtime_error{"The user bin " + filename + " is missing in " +
+                                         index_info_file(index_file).string()};
+            bin_sizes.push_back(it->second);
+        }
+        return bin_sizes;
+    }
+
+    std::vector<chopper::sketch::hyperloglog> sketches{};
+    chopper::configuration config{.data_file = options.input_file,
+                                  .k = kmer_size,
+                                  .disable_sketch_output = true,
+                                  .threads = options.threads};
+
+    chopper::sketch::execute(config, files, sketches);
+    std::vector<size_t> kmer_counts{};
+    chopper::sketch::estimate_kmer_counts(sketches, kmer_counts);
+
+    return {kmer_counts.begin(), kmer_counts.end()};
+}
+
+// Like search(), for several k-mer sizes at once: every query is read once and sketched for all k-mer sizes, the
+// sketch for options.kmer_sizes[j] is searched in options.index_files[j] and written to <output>.k<k>.
+// The size of a query is estimated by a HyperLogLog sketch per k that is filled in the same pass.
+void search_multi_k(smash_options const & options)
+{
+    size_t const number_of_kmer_sizes = options.kmer_sizes.size();
+
+    if (options.index_files.size() != number_of_kmer_sizes)
+        throw std::runtime_error{"Please provide one --indexes per --kmer-sizes."};
+    if (std::ranges::any_of(options.kmer_sizes, [] (uint8_t const k) { return k == 0 || k > 32; }))
+        throw std::runtime_error{"--kmer-sizes must be between 1 and 32."};
+    for (size_t j = 0; j < number_of_kmer_sizes; ++j) // the outputs are named by k
+        if (std::ranges::count(options.kmer_sizes, options.kmer_sizes[j]) > 1)
+            throw std::runtime_error{"--kmer-sizes " + std::to_string(options.kmer_sizes[j]) + " is given twice."};
+    if (options.checkpoint_interval > 0 || options.resume || options.numa != "none")
+        throw std::runtime_error{"--kmer-sizes does not support --checkpoint-interval, --resume and --numa."};
+    if (options.min_abundance > 1 || options.early_stop > 0 || options.sketch_error > 0.0 ||
+        options.cluster_threshold > 0.0 || std::ranges::any_of(options.files, is_sketch_file))
+        throw std::runtime_error{"--kmer-sizes does not support --min-abundance, --early-stop, --adaptive-error, "
+                                 "--cluster-threshold and precomputed sketches."};
+
+    std::vector<raptor::raptor_index<raptor::index_structure::hibf>> indexes(number_of_kmer_sizes);
+    std::vector<std::vector<uint64_t>> bin_sizes{};
+    std::vector<std::unique_ptr<checkpointed_out>> outputs{};
+
+    for (size_t j = 0; j < number_of_kmer_sizes; ++j)
+    {
+        std::string const suffix = ".k" + std::to_string(options.kmer_sizes[j]);
+        raptor::search_arguments arguments{.index_file = options.index_files[j],
+                                           .out_file = options.output_file.string() + suffix};
+
+        std::cerr << "Loading index " << options.index_files[j] << "..." << std::endl;
+        raptor::load_index(indexes[j], arguments);
+
+        std::cerr << "Computing user bin sizes for k = " << +options.kmer_sizes[j] << "..." << std::endl;
+        bin_sizes.push_back(user_bin_sizes(indexes[j], options.index_files[j], options.kmer_sizes[j], options));
+
+        outputs.push_back(std::make_unique<checkpointed_out>(arguments.out_file,
+                                                             std::chrono::seconds{0},
+                                                             false,
+                                                             options.ordered,
+                                                             options.threads * 64u));
+
+        std::string line{"#filenames"};
+        for (auto const & name : bin_references(indexes[j].bin_path(), read_index_info(options.index_files[j])))
+        {
+            line += '\t';
+            line += name;
+            line += ';';
+        }
+        line += '\n';
+        outputs[j]->write(line);
+    }
+
+    job_metrics metrics{options.metrics_file,
+                        options.progress,
+                        std::chrono::seconds{options.metrics_interval},
+                        options.files.size()};
+    metrics.add_gauge("smash_output_queue_rows", "Rows waiting to be written.", [&] ()
+    {
+        uint64_t rows{0};
+        for (auto const & output : outputs)
+            rows += output->queued_rows();
+        return rows;
+    });
+
+    std::cerr << "Computing distances..." << std::endl;
+
+    auto worker = [&](chunk_queue & chunks)
+    {
+        thread_counters & thread_metrics = metrics.register_thread();
+
+        std::vector<decltype(indexes[0].ibf().template counting_agent<uint32_t>())> counters{};
+        for (auto & index : indexes)
+            counters.push_back(index.ibf().template counting_agent<uint32_t>());
+
+        std::vector<sketch_workspace> workspaces{};
+        std::vector<chopper::sketch::hyperloglog> kmer_counts{};
+        std::string result_string{};
+
+        size_t start{};
+        size_t end{};
+        while (chunks.pop(start, end))
+        {
+            for (size_t q = start; q < end; ++q)
+            {
+                auto const & filename = options.files[q];
+                auto const query_start = std::chrono::steady_clock::now();
+                kmer_counts.assign(number_of_kmer_sizes, chopper::sketch::hyperloglog{options.hll_bits});
+                sketch_file_multi_k(filename, options, workspaces, [&] (size_t const j, uint64_t const hash)
+                {
+                    kmer_counts[j].add(reinterpret_cast<char const *>(&hash), sizeof(hash));
+                });
+                uint64_t counted_hashes{0};
+
+                for (size_t j = 0; j < number_of_kmer_sizes; ++j)
+                {
+                    std::vector<uint64_t> const & hashes = workspaces[j].hashes;
+                    uint64_t const sketch_size = sampled_hashes(hashes, options.scale, options.sketch_size);
+                    uint64_t const query_size = static_cast<uint64_t>(kmer_counts[j].estimate());
+
+                    auto & result = counters[j].bulk_count(hashes);
+                    counted_hashes += hashes.size();
+
+                    result_string.clear();
+                    result_string += filename;
+
+                    for (size_t i = 0; i < result.size(); ++i)
+                    {
+                        auto const dist = compute_distance(result[i],
+                                                           sketch_size,
+                                                           options.fpr,
+                                                           query_size,
+                                                           bin_sizes[j][i]);
+
+                        result_string += '\t';
+                        result_string += std::to_string(dist);
+                    }
+
+                    result_string += '\n';
+                    outputs[j]->write(result_string, filename, q);
+                }
+
+                thread_metrics.query_done(workspaces[0].bases, counted_hashes, query_start);
+            }
+        }
+    };
+
+    do_parallel_dynamic(worker, options.files.size(), options.threads, 1, [&] ()
+    {
+        for (auto & output : outputs)
+            output->abort();
+    });
+
+    for (auto & output : outputs)
+        output->close();
+}
@@ -0,0 +1,463 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <tuple>
+
+#include <seqan3/argument_parser/all.hpp>
+
+#include <robin_hood.h>
+
+#include "matrix_io.hpp"
+
+struct nj_options
+{
+    std::filesystem::path input_matrix_filename{};
+    std::filesystem::path output_filename{};
+    std::string distance{"jaccard"};
+    uint8_t kmer_size{32};
+    size_t threads{1};
+};
+
+int parse_command_line(nj_options & options, int const argc, char const * const * argv)
+{
+    seqan3::argument_parser parser{"neighbour_joining", argc, argv};
+
+    // Parser
+    parser.info.author = "SeqAn-Team"; // give parser some infos
+    parser.info.version = "1.0.0";
+    parser.add_option(options.input_matrix_filename, '\0', "input", "Please provide a smash matrix (text or binary) "
+                      "of all files against all files.");
+    parser.add_option(options.output_filename, '\0', "output", "The Newick file. Default: standard output.");
+    parser.add_option(options.distance, '\0', "distance", "How Jaccard indices are turned into distances: 1 - J or "
+                      "the Mash distance -1/k ln(2J / (1 + J)).", seqan3::option_spec::standard,
+                      seqan3::value_list_validator{"jaccard", "mash"});
+    parser.add_option(options.kmer_size, 'k', "kmer-size", "The k-mer size for --distance mash.");
+    parser.add_option(options.threads, 't', "threads", "The number of threads to use.");
+
+    try
+    {
+        parser.parse();                                                  // trigger command line parsing
+    }
+    catch (seqan3::argument_parser_error const & ext)                     // catch user errors
+    {
+        std::cerr << "Parsing error. " << ext.what() << "\n"; // give error message
+        return -1;
+    }
+
+    return 0;
+}
+
+// Runs fn(start, end) on `threads` threads over [0, size).
+template <typename fn_t>
+void parallel_for(size_t const size, size_t const threads, fn_t && fn)
+{
+    if (threads <= 1 || size < 1024)
+    {
+        fn(size_t{0}, size);
+        return;
+    }
+
+    std::vector<std::thread> workers{};
+    size_t const chunk_size = (size + threads - 1) / threads;
+    for (size_t start = 0; start < size; start += chunk_size)
+        workers.emplace_back(fn, start, std::min(start + chunk_size, size));
+    for (auto & worker : workers)
+        worker.join();
+}
+
+/* Neighbour joining with a RapidNJ-style bounded search for the pair to join.
+ *
+ * Distances are stored as floats in a packed lower triangle indexed by slot, a joined node reuses the slot of one of
+ * its children. For every slot, `sorted_rows` holds (distance, node id) pairs sorted by distance. Since
+ * Q(i, j) = D(i, j) - (u_i + u_j) / (r - 2) >= D(i, j) - (u_i + u_max) / (r - 2), the scan of a row can stop as soon
+ * as this bound exceeds the best Q found so far, which is usually after a few entries.
+ * Entries of joined nodes stay in the rows and are skipped; rows are rebuilt once they hold twice the live entries.
+ */
+class neighbour_joining
+{
+public:
+    neighbour_joining(std::vector<std::string> names, std::vector<float> packed_distances, size_t const threads) :
+        names{std::move(names)},
+        distances{std::move(packed_distances)},
+        threads{std::max<size_t>(threads, 1)}
+    {
+        size_t const n = this->names.size();
+
+        row_sums.resize(n);
+        slot_node.resize(n);
+        node_slot.assign(2 * n, -1);
+        live.resize(n);
+        children.resize(2 * n);
+        sorted_rows.resize(n);
+
+        for (size_t slot = 0; slot < n; ++slot)
+        {
+            slot_node[slot] = slot;
+            node_slot[slot] = slot;
+            live[slot] = slot;
+        }
+
+        next_node = n;
+
+        parallel_for(n, this->threads, [&] (size_t const start, size_t const end)
+        {
+            for (size_t a = start; a < end; ++a)
+                for (size_t b = 0; b < n; ++b)
+                    if (a != b)
+                        row_sums[a] += distance(a, b);
+        });
+
+        rebuild_rows();
+    }
+
+    std::string run()
+    {
+        if (live.size() < 3)
+            return join_remaining();
+
+        while (live.size() > 3)
+        {
+            auto const [a, b] = find_pair();
+            join(a, b);
+
+            if (row_entries > 2 * live.size() * live.size())
+                rebuild_rows();
+        }
+
+        return join_remaining();
+    }
+
+private:
+    struct candidate
+    {
+        double q{std::numeric_limits<double>::max()};
+        uint32_t a{};
+        uint32_t b{};
+
+        bool operator<(candidate const & other) const
+        {
+            return std::tie(q, a, b) < std::tie(other.q, other.a, other.b);
+        }
+    };
+
+    float & distance(size_t a, size_t b)
+    {
+        if (a < b)
+            std::swap(a, b);
+        return distances[a * (a - 1) / 2 + b];
+    }
+
+    void build_row(uint32_t const a)
+    {
+        auto & row = sorted_rows[a];
+        row.clear();
+        row.reserve(live.size() - 1);
+
+        for (uint32_t const m : live)
+            if (m != a)
+                row.emplace_back(distance(a, m), slot_node[m]);
+
+        std::ranges::sort(row);
+    }
+
+    void rebuild_rows()
+    {
+        parallel_for(live.size(), threads, [&] (size_t const start, size_t const end)
+        {
+            for (size_t i = start; i < end; ++i)
+                build_row(live[i]);
+        });
+
+        row_entries = live.size() * (live.size() - 1);
+    }
+
+    std::pair<uint32_t, uint32_t> find_pair()
+    {
+        double const r_minus_2 = static_cast<double>(live.size()) - 2.0;
+        double u_max{std::numeric_limits<double>::lowest()};
+        for (uint32_t const m : live)
+            u_max = std::max(u_max, row_sums[m]);
+
+        candidate best_overall{};
+        std::mutex best_mutex{};
+
+        parallel_for(live.size(), threads, [&] (size_t const start, size_t const end)
+        {
+            candidate best{};
+
+            for (size_t i = start; i < end; ++i)
+            {
+                uint32_t const a = live[i];
+                double const u_a = row_sums[a];
+                double const bound_offset = (u_a + u_max) / r_minus_2;
+
+                for (auto const & [d, node] : sorted_rows[a])
+                {
+                    if (d - bound_offset > best.q)
+                        break;
+
+                    int64_t const b = node_slot[node];
+                    if (b < 0 || b == a)
+                        continue;
+
+                    candidate const current{d - (u_a + row_sums[b]) / r_minus_2,
+                                            std::min<uint32_t>(a, b),
+                                            std::max<uint32_t>(a, b)};
+                    best = std::min(best, current);
+                }
+            }
+
+            std::lock_guard<std::mutex> lock{best_mutex};
+            best_overall = std::min(best_overall, best);
+        });
+
+        return {best_overall.a, best_overall.b};
+    }
+
+    void join(uint32_t const a, uint32_t const b)
+    {
+        double const r_minus_2 = static_cast<double>(live.size()) - 2.0;
+        double const d_ab = distance(a, b);
+        double const length_a = std::max(0.0, 0.5 * d_ab + (row_sums[a] - row_sums[b]) / (2.0 * r_minus_2));
+        double const length_b = std::max(0.0, d_ab - length_a);
+
+        uint32_t const node = next_node++;
+        children[node] = {{slot_node[a], length_a}, {slot_node[b], length_b}};
+
+        // slot b is removed, slot a becomes the new node
+        live.erase(std::ranges::find(live, b));
+        row_entries -= sorted_rows[b].size() + sorted_rows[a].size();
+        std::vector<std::pair<float, uint32_t>>{}.swap(sorted_rows[b]);
+
+        node_slot[slot_node[a]] = -1;
+        node_slot[slot_node[b]] = -1;
+        node_slot[node] = a;
+        slot_node[a] = node;
+
+        double new_row_sum{0.0};
+        for (uint32_t const m : live)
+        {
+            if (m == a)
+                continue;
+
+            double const d_am = distance(a, m);
+            double const d_bm = distance(b, m);
+            double const d_new = 0.5 * (d_am + d_bm - d_ab);
+
+            row_sums[m] += d_new - d_am - d_bm;
+            distance(a, m) = d_new;
+            new_row_sum += d_new;
+        }
+        row_sums[a] = new_row_sum;
+
+        build_row(a);
+        row_entries += sorted_rows[a].size();
+    }
+
+    std::string join_remaining()
+    {
+        uint32_t const root = next_node++;
+
+        if (live.size() == 3)
+        {
+            uint32_t const x = live[0];
+            uint32_t const y = live[1];
+            uint32_t const z = live[2];
+            double const d_xy = distance(x, y);
+            double const d_xz = distance(x, z);
+            double const d_yz = distance(y, z);
+
+            children[root] = {{slot_node[x], std::max(0.0, 0.5 * (d_xy + d_xz - d_yz))},
+                              {slot_node[y], std::max(0.0, 0.5 * (d_xy + d_yz - d_xz))},
+                              {slot_node[z], std::max(0.0, 0.5 * (d_xz + d_yz - d_xy))}};
+        }
+        else if (live.size() == 2)
+        {
+            children[root] = {{slot_node[live[0]], distance(live[0], live[1])}, {slot_node[live[1]], 0.0}};
+        }
+        else if (live.size() == 1)
+        {
+            children[root] = {{slot_node[live[0]], 0.0}};
+        }
+
+        return to_newick(root);
+    }
+
+    static std::string quoted(std::string const & name)
+    {
+        if (name.find_first_of("()[]':;, \t") == std::string::npos)
+            return name;
+
+        std::string result{"'"};
+        for (char const c : name)
+        {
+            if (c == '\'')
+                result += '\'';
+            result += c;
+        }
+        result += '\'';
+        return result;
+    }
+
+    // iterative, caterpillar-like trees of 100k taxa would overflow the stack otherwise
+    std::string to_newick(uint32_t const root) const
+    {
+        std::string result{};
+        std::vector<std::tuple<uint32_t, double, size_t>> stack{{root, 0.0, 0}}; // node, length, next child
+
+        while (!stack.empty())
+        {
+            auto & [node, length, next_child] = stack.back();
+            auto const & node_children = children[node];
+
+            if (node < names.size())
+            {
+                result += quoted(names[node]);
+            }
+            else if (next_child < node_children.size())
+            {
+                result += (next_child == 0) ? '(' : ',';
+                auto const [child, child_length] = node_children[next_child++];
+                stack.emplace_back(child, child_length, 0);
+                continue;
+            }
+            else
+            {
+                result += ')';
+            }
+
+            if (stack.size() > 1)
+            {
+                result += ':';
+                result += std::to_string(length);
+            }
+            stack.pop_back();
+        }
+
+        result += ";\n";
+        return result;
+    }
+
+    std::vector<std::string> names{};
+    std::vector<float> distances{};
+    size_t threads{};
+
+    std::vector<double> row_sums{};
+    std::vector<uint32_t> slot_node{};
+    std::vector<int64_t> node_slot{};
+    std::vector<uint32_t> live{};
+    std::vector<std::vector<std::pair<float, uint32_t>>> sorted_rows{};
+    size_t row_entries{0};
+
+    std::vector<std::vector<std::pair<uint32_t, double>>> children{};
+    uint32_t next_node{};
+};
+
+double to_distance(double const jaccard, nj_options const & options)
+{
+    double const j = std::clamp(jaccard, 0.0, 1.0);
+
+    if (options.distance == "mash")
+        return (j <= 0.0) ? 1.0 : std::min(1.0, -std::log(2.0 * j / (1.0 + j)) / options.kmer_size);
+
+    return 1.0 - j;
+}
+
+// The taxa are the files that are both a row and a column of the matrix, their symmetric distances are returned as a
+// packed lower triangle. The matrix is read row by row into that triangle, indexed by column, so it never holds more
+// than one float per pair of columns.
+std::vector<float> read_distances(nj_options const & options, std::vector<std::string> & names)
+{
+    std::vector<std::string> column_names{};
+    robin_hood::unordered_map<std::string, size_t> column_of{};
+    std::vector<bool> is_taxon{}; // the column's row was read
+    std::vector<float> distances{};
+    size_t ignored_rows{0};
+
+    auto packed = [] (size_t const a, size_t const b) { return (a > b) ? a * (a - 1) / 2 + b : b * (b - 1) / 2 + a; };
+
+    read_matrix_rows(options.input_matrix_filename,
+                     [&] (std::vector<std::string> const & columns)
+                     {
+                         column_names = columns;
+                         for (size_t column = 0; column < columns.size(); ++column)
+                             column_of.emplace(columns[column], column);
+                         is_taxon.assign(columns.size(), false);
+                         distances.assign(columns.empty() ? 0 : columns.size() * (columns.size() - 1) / 2, 0.0f);
+                     },
+                     [&] (std::string const & name, std::vector<double> const & values)
+                     {
+                         auto const it = column_of.find(name);
+                         if (it == column_of.end())
+                         {
+                             ++ignored_rows;
+                             return;
+                         }
+
+                         size_t const a = it->second;
+                         if (is_taxon[a])
+                             throw std::runtime_error{"The row " + name + " appears twice in the matrix."};
+                         is_taxon[a] = true;
+
+                         // the distance of a pair is the mean of both directions
+                         for (size_t b = 0; b < values.size(); ++b)
+                             if (b != a)
+                                 distances[packed(a, b)] += 0.5 * to_distance(values[b], options);
+                     });
+
+    if (ignored_rows > 0)
+        std::cerr << "[WARNING] " << ignored_rows << " rows are not columns of the matrix and are ignored.\n";
+
+    // Drop the columns without a row. A taxon's packed index never increases, so the triangle is compacted in place.
+    std::vector<size_t> taxon_columns{};
+    for (size_t column = 0; column < column_names.size(); ++column)
+        if (is_taxon[column])
+            taxon_columns.push_back(column);
+
+    if (taxon_columns.size() < column_names.size())
+    {
+        for (size_t a = 1; a < taxon_columns.size(); ++a)
+            for (size_t b = 0; b < a; ++b)
+                distances[packed(a, b)] = distances[packed(taxon_columns[a], taxon_columns[b])];
+
+        distances.resize(taxon_columns.empty() ? 0 : taxon_columns.size() * (taxon_columns.size() - 1) / 2);
+        distances.shrink_to_fit();
+    }
+
+    for (size_t const column : taxon_columns)
+        names.push_back(column_names[column]);
+
+    return distances;
+}
+
+int main(int argc, char ** argv)
+{
+    nj_options options{};
+    if (parse_command_line(options, argc, argv) != 0)
+        return -1;
+
+    std::vector<std::string> names{};
+    std::vector<float> distances = read_distances(options, names);
+
+    if (names.empty())
+        throw std::runtime_error{"The matrix has no taxa, i.e. no file that is both a row and a column."};
+
+    neighbour_joining nj{std::move(names), std::move(distances), options.threads};
+    std::string const newick = nj.run();
+
+    if (options.output_filename.empty())
+    {
+        std::cout << newick;
+    }
+    else
+    {
+        std::ofstream fout{options.output_filename};
+        fout << newick;
+    }
+
+    return 0;
+}
@@ -1,3 +1,5 @@
+#include <limits>
+
 #include <seqan3/search/views/kmer_hash.hpp>
 
 #include <chopper/sketch/hyperloglog.hpp>
@@ -7,31 +9,69 @@
 #include <raptor/argument_parsing/search_arguments.hpp>
 #include <raptor/adjust_seed.hpp>
 #include <raptor/dna4_traits.hpp>
-#include <raptor/search/do_parallel.hpp>
 #include <raptor/search/load_index.hpp>
-#include <raptor/search/sync_out.hpp>
 
+#include "checkpoint.hpp"
 #include "compute_distance.hpp"
+#include "index_info.hpp"
+#include "metrics.hpp"
+#include "numa.hpp"
+#include "parallel.hpp"
 #include "search.hpp"
 #include "options.hpp"
-#include "sketch.hpp"
-
-struct my_traits : seqan3::sequence_file_input_default_traits_dna
-{
-    using sequence_alphabet = seqan3::dna4; // instead of dna5
-};
+#include "sketch_file.hpp"
+#include "union_find.hpp"
 
 void search(smash_options & options)
 {
-    auto index = raptor::raptor_index<raptor::index_structure::hibf>{};
-
     raptor::search_arguments arguments{.index_file = options.index_file,
                                        .out_file = options.output_file};
 
-    raptor::load_index(index, arguments);
+    numa_placement numa{};
+
+    // With --numa replicate there is one copy of the index per node, each placed on its node.
+    size_t const number_of_replicas = (options.numa == "replicate") ? numa.nodes() : 1;
+    std::vector<raptor::raptor_index<raptor::index_structure::hibf>> replicas(number_of_replicas);
 
+    for (size_t node = 0; node < replicas.size(); ++node)
     {
-        std::vector<std::string> files = options.files;
+        if (options.numa == "interleave")
+            numa.interleave_memory();
+        else if (options.numa == "replicate")
+            numa.bind_memory(node);
+
+        raptor::load_index(replicas[node], arguments);
+        numa.reset_memory_policy();
+    }
+
+    auto & index = replicas[0];
+
+    // A thread only searches the replica on its own node if it stays on that node, so replicas imply pinning.
+    bool const pin_threads = options.pin_threads || options.numa == "replicate";
+
+    // filtered or partially read queries: the size is estimated from the sketch itself
+    bool const size_from_sketch = options.min_abundance > 1 || (options.early_stop > 0 && options.scale == 0);
+
+    // indexes built by `smash index` record the sizes of their user bins
+    std::optional<index_info> const info = read_index_info(options.index_file);
+    if (info)
+    {
+        check_index_info(*info, options.index_file, options.kmer_size, options);
+        for (size_t i = 0; i < info->bin_paths.size(); ++i)
+            options.sizes.emplace(info->bin_paths[i], info->sizes[i]);
+    }
+
+    {
+        // precomputed sketches store their k-mer count, everything else is estimated by HyperLogLog
+        std::vector<std::string> files{};
+        for (auto const & filename : options.files)
+        {
+            if (is_sketch_file(filename))
+                options.sizes.emplace(filename, read_sketch_header(filename).kmer_count);
+            else if (!size_from_sketch || options.sketch_error > 0.0) // the adaptive sketch size needs the size
+                files.push_back(filename);
+        }
+
         std::vector<chopper::sketch::hyperloglog> sketches{};
 
         chopper::configuration config{.data_file = options.input_file,
@@ -41,82 +81,213 @@ void search(smash_options & options)
 
         for (size_t i = 0; i < index.bin_path().size(); ++i)
         {
-            files.push_back(index.bin_path()[i][0]);
             if (index.bin_path()[i].size() > 1)
                 throw std::runtime_error{"Multi file user bins not supported yet."};
+            if (!info)
+                files.push_back(index.bin_path()[i][0]);
         }
 
-        chopper::sketch::execute(config, files, sketches);
-        std::vector<size_t> kmer_counts{};
-        chopper::sketch::estimate_kmer_counts(sketches, kmer_counts);
+        if (!files.empty())
+        {
+            chopper::sketch::execute(config, files, sketches);
+            std::vector<size_t> kmer_counts{};
+            chopper::sketch::estimate_kmer_counts(sketches, kmer_counts);
 
-        for (size_t i = 0; i < files.size(); ++i)
-            options.sizes.emplace(files[i], static_cast<uint64_t>(kmer_counts[i]));
+            for (size_t i = 0; i < files.size(); ++i)
+                options.sizes.emplace(files[i], static_cast<uint64_t>(kmer_counts[i]));
+        }
     }
 
-    raptor::sync_out synced_out{arguments};
+    // the names of the user bins in the header and for clustering, their sizes are keyed by the bin paths
+    std::vector<std::string> const bin_names = bin_references(index.bin_path(), info);
+    std::vector<uint64_t> bin_sizes{};
+    for (auto const & filenames : index.bin_path())
+        bin_sizes.push_back(options.sizes.at(filenames[0]));
+
+    bool const clustering = options.cluster_threshold > 0.0;
+    if (clustering && options.resume)
+        throw std::runtime_error{"--resume is not supported for --cluster-threshold."};
+
+    // Clustering: vertices are the queries followed by the user bins that are not queries themselves.
+    std::vector<std::string> vertex_names{};
+    robin_hood::unordered_map<std::string, uint32_t> vertex_of{};
+    std::vector<uint32_t> bin_vertices{};
+    if (clustering)
+    {
+        auto add_vertex = [&] (std::string const & name)
+        {
+            auto const [it, inserted] = vertex_of.emplace(name, vertex_names.size());
+            if (inserted)
+                vertex_names.push_back(name);
+            return it->second;
+        };
+
+        for (auto const & filename : options.files)
+            add_vertex(filename);
+        for (auto const & name : bin_names)
+            bin_vertices.push_back(add_vertex(name));
+    }
+    concurrent_union_find clusters{vertex_names.size()};
 
-    { // write header line
+    checkpointed_out synced_out{options.output_file,
+                                std::chrono::seconds{options.checkpoint_interval},
+                                options.resume,
+                                options.ordered,
+                                options.threads * 64u};
+
+    std::vector<std::string> queries{};
+    if (synced_out.is_resumed())
+    {
+        for (auto const & filename : options.files)
+            if (synced_out.completed_queries().count(filename) == 0)
+                queries.push_back(filename);
+
+        std::cerr << "Resuming: " << (options.files.size() - queries.size()) << " of " << options.files.size()
+                  << " queries are already done." << std::endl;
+    }
+    else
+    {
+        queries = options.files;
+    }
+
+    if (!synced_out.is_resumed() && !clustering) // write header line
+    {
         std::string line{"#filenames"};
-        for (auto const & filenames : index.bin_path())
+        for (auto const & name : bin_names)
         {
             line += '\t';
-            for (auto const & filename : filenames)
-            {
-                line += filename;
-                line += ';';
-            }
+            line += name;
+            line += ';';
         }
         line += '\n';
         synced_out.write(line);
     }
 
+    job_metrics metrics{options.metrics_file,
+                        options.progress,
+                        std::chrono::seconds{options.metrics_interval},
+                        queries.size()};
+    metrics.add_gauge("smash_output_queue_rows", "Rows waiting to be written.",
+                      [&] () { return synced_out.queued_rows(); });
+
     std::vector<std::string> filenames{};
+    size_t first_query{0}; // index of filenames[0] in `queries`, for the ordered output
 
-    auto worker = [&](size_t const start, size_t const end)
+    // filename + one "\t0.123456" per bin
+    size_t const max_row_length = 4096 + index.bin_path().size() * 16;
+
+    auto worker = [&](chunk_queue & chunks)
     {
-        auto counter = index.ibf().template counting_agent<uint32_t>();
+        // pin first, such that the counting agent and all buffers are allocated on the thread's node
+        size_t const node = numa.assign_thread(pin_threads);
+        auto counter = replicas[node % replicas.size()].ibf().template counting_agent<uint32_t>();
+        thread_counters & thread_metrics = metrics.register_thread();
 
+        sketch_workspace workspace{};
         std::string result_string{};
+        result_string.reserve(max_row_length);
 
-        for (auto && filename : filenames | seqan3::views::slice(start, end))
+        size_t start{};
+        size_t end{};
+        while (chunks.pop(start, end))
         {
-            result_string.clear();
-            result_string += filename;
-
-            my_priority_queue<uint64_t> sketch{};
-            for (auto && rec : seqan3::sequence_file_input<my_traits>{filename})
+            for (size_t q = start; q < end; ++q)
             {
-                if (sketch.empty())
-                    init_sketch(rec.sequence(), options.kmer_size, options.sketch_size, sketch);
-                else
-                    add_to_sketch(rec.sequence(), options.kmer_size, sketch);
-            }
+                auto const & filename = filenames[q];
+                auto const query_start = std::chrono::steady_clock::now();
 
-            auto & result = counter.bulk_count(sketch.get_underlying_container());
+                result_string.clear();
+                result_string += filename;
 
-            for (size_t i = 0; i < result.size(); ++i)
-            {
-                auto const dist = compute_distance(result[i],
-                                                   options.sketch_size,
-                                                   options.fpr,
-                                                   options.sizes.at(filename),
-                                                   options.sizes.at(index.bin_path()[i][0]));
-
-                result_string += '\t';
-                result_string += std::to_string(dist);
-            }
+                uint32_t query_sketch_size{options.sketch_size};
+                if (options.sketch_error > 0.0)
+                    query_sketch_size = adaptive_sketch_size(options.sizes.at(filename),
+                                                             options.sketch_error,
+                                                             options.min_sketch_size,
+                                                             options.max_sketch_size);
+
+                sketch_file(filename, options, workspace, query_sketch_size);
+                std::vector<uint64_t> const & hashes = workspace.hashes;
+
+                uint64_t const sketch_size = sampled_hashes(hashes, options.scale, query_sketch_size);
+
+                // the HyperLogLog estimate would include the filtered or unread k-mers
+                uint64_t const query_size =
+                    (size_from_sketch && !is_sketch_file(filename))
+                        ? sketch_cardinality(hashes, options.kmer_size, options.scale, query_sketch_size)
+                        : options.sizes.at(filename);
+
+                auto & result = counter.bulk_count(hashes);
+
+                for (size_t i = 0; i < result.size(); ++i)
+                {
+                    auto const dist = compute_distance(result[i],
+                                                       sketch_size,
+                                                       options.fpr,
+                                                       query_size,
+                                                       bin_sizes[i]);
+
+                    if (clustering)
+                    {
+                        if (dist >= options.cluster_threshold)
+                            clusters.unite(vertex_of.at(filename), bin_vertices[i]);
+                        continue;
+                    }
+
+                    result_string += '\t';
+                    result_string += std::to_string(dist);
+                }
+
+                thread_metrics.query_done(workspace.bases, hashes.size(), query_start);
+
+                if (clustering)
+                    continue;
 
-            result_string += '\n';
-            synced_out.write(result_string);
+                result_string += '\n';
+                synced_out.write(result_string, filename, first_query + q);
+            }
         }
     };
 
-    for (auto && chunked_files : options.files | seqan3::views::chunk((1ULL << 20) * 10))
+    for (auto && chunked_files : queries | seqan3::views::chunk((1ULL << 20) * 10))
     {
         filenames.clear();
         std::ranges::move(chunked_files, std::back_inserter(filenames));
 
-        raptor::do_parallel(worker, filenames.size(), options.threads);
+        numa.reset_threads();
+        do_parallel_dynamic(worker, filenames.size(), options.threads, 1, [&] () { synced_out.abort(); });
+        first_query += filenames.size();
+    }
+
+    if (clustering) // write cluster assignments, clusters are numbered by their first file
+    {
+        std::vector<uint32_t> cluster_ids(vertex_names.size(), std::numeric_limits<uint32_t>::max());
+        uint32_t number_of_clusters{0};
+        std::string line{"#filename\tcluster\trepresentative\n"};
+
+        for (uint32_t vertex = 0; vertex < vertex_names.size(); ++vertex)
+        {
+            uint32_t const representative = clusters.find(vertex);
+            if (cluster_ids[representative] == std::numeric_limits<uint32_t>::max())
+                cluster_ids[representative] = number_of_clusters++;
+
+            line += vertex_names[vertex];
+            line += '\t';
+            line += std::to_string(cluster_ids[representative]);
+            line += '\t';
+            line += vertex_names[representative];
+            line += '\n';
+
+            if (line.size() > (1ULL << 20))
+            {
+                synced_out.write(line);
+                line.clear();
+            }
+        }
+
+        synced_out.write(line);
+        std::cerr << "Found " << number_of_clusters << " clusters." << std::endl;
     }
+
+    synced_out.close();
 }
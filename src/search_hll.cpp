@@ -1,105 +1,124 @@
-#include <seqan3/search/views/kmer_hash.hpp>
+#include <algorithm>
+#include <iostream>
 
-#include <raptor/adjust_seed.hpp>
-#include <raptor/dna4_traits.hpp>
-#include <raptor/search/do_parallel.hpp>
-#include <raptor/search/load_index.hpp>
-#include <raptor/search/sync_out.hpp>
+#include <chopper/sketch/hyperloglog.hpp>
+#include <chopper/sketch/execute.hpp>
 
-#include "compute_distance.hpp"
-#include "search.hpp"
+#include "checkpoint.hpp"
+#include "metrics.hpp"
+#include "parallel.hpp"
+#include "search_hll.hpp"
 #include "options.hpp"
-#include "sketch.hpp"
 
-struct my_traits : seqan3::sequence_file_input_default_traits_dna
+// Jaccard index estimate by inclusion–exclusion: |A ∩ B| = |A| + |B| - |A ∪ B|
+// The union is estimated from the register-wise maximum of both sketches.
+double hll_jaccard(chopper::sketch::hyperloglog const & a,
+                   double const size_of_a,
+                   chopper::sketch::hyperloglog const & b,
+                   double const size_of_b,
+                   chopper::sketch::hyperloglog & buffer)
 {
-    using sequence_alphabet = seqan3::dna4; // instead of dna5
-};
+    buffer = a;
+    double const union_size = buffer.merge_and_estimate_SIMD(b);
 
+    if (union_size <= 0.0)
+        return 0.0;
+
+    double const intersection_size = size_of_a + size_of_b - union_size;
+    return std::clamp(intersection_size / union_size, 0.0, 1.0);
+}
+
+// Approximate all-vs-all matrix of the input files. No index is needed, every file is represented by a single
+// HyperLogLog sketch of 2^hll_bits bytes.
 void search_hll(smash_options const & options)
 {
-    auto index = raptor::raptor_index<raptor::index_structure::hibf>{};
+    std::vector<chopper::sketch::hyperloglog> sketches{};
 
-    double index_io_time{0.0};
-    double reads_io_time{0.0};
-    double compute_time{0.0};
+    std::cerr << "Computing HyperLogLog sketches..." << std::endl;
+    {
+        chopper::configuration config{.data_file = options.input_file,
+                                      .k = options.kmer_size,
+                                      .sketch_bits = options.hll_bits,
+                                      .disable_sketch_output = true,
+                                      .threads = options.threads};
 
-    raptor::load_index(index, options.index_file, index_io_time);
+        chopper::sketch::execute(config, options.files, sketches);
+    }
 
-    std::vector<std::string> filenames{};
+    std::vector<double> estimates{};
+    estimates.reserve(sketches.size());
+    for (auto const & sketch : sketches)
+        estimates.push_back(sketch.estimate());
 
-    raptor::sync_out synced_out{options.output_file};
+    checkpointed_out synced_out{options.output_file,
+                                std::chrono::seconds{options.checkpoint_interval},
+                                options.resume,
+                                options.ordered,
+                                options.threads * 256u};
 
-    { // write header line
+    if (!synced_out.is_resumed()) // write header line
+    {
         std::string line{"#filenames"};
-        for (auto const & filenames : index.bin_path())
+        for (auto const & filename : options.files)
         {
             line += '\t';
-            for (auto const & filename : filenames)
-            {
-                line += filename;
-                line += ';';
-            }
+            line += filename;
+            line += ';';
         }
         line += '\n';
-        synced_out << line;
+        synced_out.write(line);
     }
 
-    auto worker = [&](size_t const start, size_t const end)
-    {
-        auto counter = index.ibf().template counting_agent<uint32_t>();
+    std::cerr << "Computing distances..." << std::endl;
 
+    // the queries that are not done yet
+    std::vector<size_t> queries{};
+    for (size_t i = 0; i < options.files.size(); ++i)
+        if (synced_out.completed_queries().count(options.files[i]) == 0)
+            queries.push_back(i);
+
+    // the files are read before, a row only compares sketches
+    job_metrics metrics{options.metrics_file,
+                        options.progress,
+                        std::chrono::seconds{options.metrics_interval},
+                        queries.size()};
+    metrics.add_gauge("smash_output_queue_rows", "Rows waiting to be written.",
+                      [&] () { return synced_out.queued_rows(); });
+
+    auto worker = [&](chunk_queue & chunks)
+    {
+        thread_counters & thread_metrics = metrics.register_thread();
+        chopper::sketch::hyperloglog buffer{options.hll_bits};
         std::string result_string{};
 
-        for (auto && filename : filenames | seqan3::views::slice(start, end))
+        size_t start{};
+        size_t end{};
+        while (chunks.pop(start, end))
         {
-            result_string.clear();
-            result_string += filename;
-
-            my_priority_queue<uint64_t> sketch{};
-            for (auto && rec : seqan3::sequence_file_input<my_traits>{filename})
+            for (size_t q = start; q < end; ++q)
             {
-                if (sketch.empty())
-                    init_sketch(rec.sequence(), options.kmer_size, options.sketch_size, sketch);
-                else
-                    add_to_sketch(rec.sequence(), options.kmer_size, sketch);
-            }
+                size_t const i = queries[q];
+                auto const & filename = options.files[i];
+                auto const query_start = std::chrono::steady_clock::now();
 
-            auto & result = counter.bulk_count(sketch.get_underlying_container());
+                result_string.clear();
+                result_string += filename;
 
-            for (auto && count : result)
-            {
-                auto const dist = compute_distance(count, options.sketch_size);
+                for (size_t j = 0; j < sketches.size(); ++j)
+                {
+                    auto const dist = hll_jaccard(sketches[i], estimates[i], sketches[j], estimates[j], buffer);
 
-                result_string += '\t';
-                result_string += std::to_string(dist);
-            }
+                    result_string += '\t';
+                    result_string += std::to_string(dist);
+                }
 
-            result_string += '\n';
-            synced_out.write(result_string);
+                result_string += '\n';
+                synced_out.write(result_string, filename, q);
+                thread_metrics.query_done(0, 0, query_start);
+            }
         }
     };
 
-    for (auto && chunked_files : options.files | seqan3::views::chunk((1ULL << 20) * 10))
-    {
-        filenames.clear();
-        auto start = std::chrono::high_resolution_clock::now();
-        std::ranges::move(chunked_files, std::back_inserter(filenames));
-        auto end = std::chrono::high_resolution_clock::now();
-        reads_io_time += std::chrono::duration_cast<std::chrono::duration<double>>(end - start).count();
-
-        raptor::do_parallel(worker, filenames.size(), options.threads, compute_time);
-    }
-
-    // GCOVR_EXCL_START
-    if (options.write_time)
-    {
-        std::filesystem::path file_path{options.output_file};
-        file_path += ".time";
-        std::ofstream file_handle{file_path};
-        file_handle << "Index I/O\tReads I/O\tCompute\n";
-        file_handle << std::fixed << std::setprecision(2) << index_io_time << '\t' << reads_io_time << '\t'
-                    << compute_time;
-    }
-    // GCOVR_EXCL_STOP
+    do_parallel_dynamic(worker, queries.size(), options.threads, 16, [&] () { synced_out.abort(); });
+    synced_out.close();
 }
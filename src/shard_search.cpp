@@ -0,0 +1,377 @@
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <optional>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <chopper/sketch/hyperloglog.hpp>
+#include <chopper/sketch/execute.hpp>
+#include <chopper/sketch/estimate_kmer_counts.hpp>
+
+#include <raptor/argument_parsing/search_arguments.hpp>
+#include <raptor/search/load_index.hpp>
+
+#include "checkpoint.hpp"
+#include "compute_distance.hpp"
+#include "index_info.hpp"
+#include "metrics.hpp"
+#include "multi_k_search.hpp"
+#include "options.hpp"
+#include "parallel.hpp"
+#include "shard_search.hpp"
+#include "sketch_file.hpp"
+#include "sketch_io.hpp"
+
+// Appends the columns of every further part to the rows of the first part, line by line.
+void join_columns(std::vector<std::filesystem::path> const & parts, std::filesystem::path const & output_file)
+{
+    std::vector<std::ifstream> fins{};
+    for (auto const & part : parts)
+    {
+        fins.emplace_back(part);
+        if (!fins.back().good())
+            throw std::runtime_error{"Could not open file " + part.string()};
+    }
+
+    std::ofstream fout{output_file};
+    if (!fout.good())
+        throw std::runtime_error{"Could not open file " + output_file.string()};
+
+    std::string line{};
+    std::string part_line{};
+    while (std::getline(fins[0], line))
+    {
+        for (size_t p = 1; p < fins.size(); ++p)
+        {
+            if (!std::getline(fins[p], part_line))
+                throw std::runtime_error{parts[p].string() + " has fewer rows than " + parts[0].string()};
+
+            line.append(part_line, std::min(part_line.find('\t'), part_line.size()));
+        }
+
+        line += '\n';
+        fout << line;
+    }
+}
+
+/* The query sketches for the index groups after the first. Every thread appends the sketches it computes to its own
+ * file <output>.sketches<thread>, later groups read them back by position. Memory does not grow with the number of
+ * queries, the files are removed at the end.
+ */
+class sketch_spill
+{
+public:
+    sketch_spill(std::filesystem::path const & output_file, size_t const number_of_queries) :
+        prefix{output_file.string() + ".sketches"},
+        locations(number_of_queries)
+    {}
+
+    sketch_spill(sketch_spill const &) = delete;
+    sketch_spill & operator=(sketch_spill const &) = delete;
+
+    ~sketch_spill()
+    {
+        for (size_t t = 0; t < files.size(); ++t)
+        {
+            ::close(files[t].descriptor);
+            std::filesystem::remove(prefix + std::to_string(t));
+        }
+    }
+
+    // a new file for the calling thread
+    size_t add_thread()
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        std::string const filename = prefix + std::to_string(files.size());
+
+        int const descriptor = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (descriptor < 0)
+            throw std::runtime_error{"Could not open file " + filename};
+
+        files.push_back(spill_file{descriptor, 0});
+        return files.size() - 1;
+    }
+
+    void write(size_t const thread, size_t const query, std::vector<uint64_t> const & hashes)
+    {
+        spill_file & file = files[thread];
+        size_t const bytes = hashes.size() * sizeof(uint64_t);
+
+        if (::pwrite(file.descriptor, hashes.data(), bytes, file.size) != static_cast<ssize_t>(bytes))
+            throw std::runtime_error{"Could not write to " + prefix + std::to_string(thread)};
+
+        locations[query] = location{thread, file.size, hashes.size()};
+        file.size += bytes;
+    }
+
+    // only after all writes are done
+    void read(size_t const query, std::vector<uint64_t> & hashes) const
+    {
+        location const & where = locations[query];
+        size_t const bytes = where.hashes * sizeof(uint64_t);
+        hashes.resize(where.hashes);
+
+        if (::pread(files[where.file].descriptor, hashes.data(), bytes, where.offset) != static_cast<ssize_t>(bytes))
+            throw std::runtime_error{"Could not read " + prefix + std::to_string(where.file)};
+    }
+
+private:
+    struct spill_file
+    {
+        int descriptor{-1};
+        uint64_t size{0}; // only changed by the owning thread
+    };
+
+    struct location
+    {
+        size_t file{};
+        uint64_t offset{};
+        uint64_t hashes{};
+    };
+
+    std::string prefix{};
+    std::vector<location> locations{};
+    std::deque<spill_file> files{}; // a deque does not move its elements
+    std::mutex mutex{};
+};
+
+// Searches every query in all options.index_files, indexes over disjoint sets of references, and writes one row with
+// the columns of all indexes. A query is sketched only once.
+// Without --index-memory, all indexes are loaded and each query is counted in all of them at once. Otherwise, the
+// indexes are loaded in groups whose files fit into the budget: the first group spills the query sketches to disk
+// (see sketch_spill), each group writes <output>.part<group> and the parts are joined in the end. The memory is then
+// bounded by the largest group and the per-thread buffers; a single index larger than the budget forms a group alone.
+void search_index_shards(smash_options const & options)
+{
+    if (options.sketch_error > 0.0 || options.cluster_threshold > 0.0 || options.resume ||
+        options.checkpoint_interval > 0 || options.numa != "none")
+        throw std::runtime_error{"Several --indexes do not support --adaptive-error, --cluster-threshold, "
+                                 "--checkpoint-interval, --resume and --numa."};
+
+    size_t const number_of_shards = options.index_files.size();
+    size_t const number_of_queries = options.files.size();
+
+    // The query sizes as search() computes them: precomputed sketches store their k-mer count, filtered or partially
+    // read queries are estimated from their sketch while searching, everything else by HyperLogLog.
+    bool const size_from_sketch = options.min_abundance > 1 || (options.early_stop > 0 && options.scale == 0);
+    std::vector<uint64_t> query_sizes(number_of_queries);
+    {
+        std::vector<std::string> files{};
+        std::vector<size_t> positions{};
+        for (size_t q = 0; q < number_of_queries; ++q)
+        {
+            if (is_sketch_file(options.files[q]))
+            {
+                query_sizes[q] = read_sketch_header(options.files[q]).kmer_count;
+            }
+            else if (!size_from_sketch)
+            {
+                files.push_back(options.files[q]);
+                positions.push_back(q);
+            }
+        }
+
+        if (!files.empty())
+        {
+            std::cerr << "Estimating query sizes..." << std::endl;
+            chopper::configuration config{.data_file = options.input_file,
+                                          .k = options.kmer_size,
+                                          .disable_sketch_output = true,
+                                          .threads = options.threads};
+
+            std::vector<chopper::sketch::hyperloglog> sketches{};
+            chopper::sketch::execute(config, files, sketches);
+            std::vector<size_t> kmer_counts{};
+            chopper::sketch::estimate_kmer_counts(sketches, kmer_counts);
+
+            for (size_t i = 0; i < files.size(); ++i)
+                query_sizes[positions[i]] = kmer_counts[i];
+        }
+    }
+
+    // groups of consecutive shards [first, last) that are loaded together
+    std::vector<std::pair<size_t, size_t>> groups{};
+    {
+        uint64_t const budget = options.index_memory << 20;
+        uint64_t used{0};
+        size_t first{0};
+
+        for (size_t j = 0; j < number_of_shards; ++j)
+        {
+            uint64_t const size = std::filesystem::file_size(options.index_files[j]);
+            if (budget > 0 && j > first && used + size > budget)
+            {
+                groups.emplace_back(first, j);
+                first = j;
+                used = 0;
+            }
+            used += size;
+        }
+        groups.emplace_back(first, number_of_shards);
+    }
+
+    bool const keep_sketches = groups.size() > 1;
+    std::optional<sketch_spill> sketches{};
+    if (keep_sketches)
+        sketches.emplace(options.output_file, number_of_queries);
+    std::vector<std::filesystem::path> parts{};
+
+    if (keep_sketches)
+        std::cerr << "Searching " << number_of_shards << " indexes in " << groups.size() << " groups..." << std::endl;
+
+    // The output of the group that is searched, replaced between groups. It outlives the metrics, whose gauge reads it.
+    std::mutex output_mutex{};
+    std::optional<checkpointed_out> synced_out{};
+
+    // one job for all groups: every group searches all queries, the worker threads keep their counters
+    job_metrics metrics{options.metrics_file,
+                        options.progress,
+                        std::chrono::seconds{options.metrics_interval},
+                        number_of_queries * groups.size()};
+    metrics.add_gauge("smash_output_queue_rows", "Rows waiting to be written.", [&] () -> uint64_t
+    {
+        std::lock_guard<std::mutex> lock{output_mutex};
+        return synced_out ? synced_out->queued_rows() : 0;
+    });
+
+    std::vector<thread_counters *> worker_metrics{};
+    for (size_t t = 0; t < std::max<size_t>(options.threads, 1); ++t)
+        worker_metrics.push_back(&metrics.register_thread());
+
+    for (size_t g = 0; g < groups.size(); ++g)
+    {
+        auto const [first, last] = groups[g];
+
+        std::vector<raptor::raptor_index<raptor::index_structure::hibf>> indexes(last - first);
+        std::vector<std::vector<uint64_t>> bin_sizes{};
+
+        for (size_t j = first; j < last; ++j)
+        {
+            raptor::search_arguments arguments{.index_file = options.index_files[j],
+                                               .out_file = options.output_file};
+
+            std::cerr << "Loading index " << options.index_files[j] << "..." << std::endl;
+            raptor::load_index(indexes[j - first], arguments);
+            bin_sizes.push_back(user_bin_sizes(indexes[j - first], options.index_files[j], options.kmer_size, options));
+        }
+
+        std::filesystem::path const out_file =
+            keep_sketches ? std::filesystem::path{options.output_file.string() + ".part" + std::to_string(g)}
+                          : options.output_file;
+        parts.push_back(out_file);
+
+        // the parts are joined row by row, so their rows must be in the same order
+        {
+            std::lock_guard<std::mutex> lock{output_mutex};
+            synced_out.emplace(out_file,
+                               std::chrono::seconds{0},
+                               false,
+                               options.ordered || keep_sketches,
+                               options.threads * 64u);
+        }
+
+        { // write header line
+            std::string line{"#filenames"};
+            for (size_t j = first; j < last; ++j)
+            {
+                for (auto const & name : bin_references(indexes[j - first].bin_path(),
+                                                        read_index_info(options.index_files[j])))
+                {
+                    line += '\t';
+                    line += name;
+                    line += ';';
+                }
+            }
+            line += '\n';
+            synced_out->write(line);
+        }
+
+        std::cerr << "Computing distances..." << std::endl;
+
+        std::atomic<size_t> next_worker{0};
+        auto worker = [&] (chunk_queue & chunks)
+        {
+            thread_counters & thread_metrics = *worker_metrics[next_worker++];
+
+            std::vector<decltype(indexes[0].ibf().template counting_agent<uint32_t>())> counters{};
+            for (auto & index : indexes)
+                counters.push_back(index.ibf().template counting_agent<uint32_t>());
+
+            sketch_workspace workspace{};
+            std::string result_string{};
+            size_t const spill_file = (keep_sketches && g == 0) ? sketches->add_thread() : 0;
+
+            size_t start{};
+            size_t end{};
+            while (chunks.pop(start, end))
+            {
+                for (size_t q = start; q < end; ++q)
+                {
+                    auto const & filename = options.files[q];
+                    auto const query_start = std::chrono::steady_clock::now();
+
+                    if (g == 0) // sketch once
+                    {
+                        sketch_file(filename, options, workspace);
+                        if (size_from_sketch && !is_sketch_file(filename))
+                            query_sizes[q] = sketch_cardinality(workspace.hashes,
+                                                                options.kmer_size,
+                                                                options.scale,
+                                                                options.sketch_size);
+                        if (keep_sketches)
+                            sketches->write(spill_file, q, workspace.hashes);
+                    }
+                    else
+                    {
+                        sketches->read(q, workspace.hashes);
+                    }
+
+                    std::vector<uint64_t> const & hashes = workspace.hashes;
+                    uint64_t const sketch_size = sampled_hashes(hashes, options.scale, options.sketch_size);
+
+                    result_string.clear();
+                    result_string += filename;
+
+                    for (size_t j = 0; j < counters.size(); ++j)
+                    {
+                        auto & result = counters[j].bulk_count(hashes);
+
+                        for (size_t i = 0; i < result.size(); ++i)
+                        {
+                            auto const dist = compute_distance(result[i],
+                                                               sketch_size,
+                                                               options.fpr,
+                                                               query_sizes[q],
+                                                               bin_sizes[j][i]);
+
+                            result_string += '\t';
+                            result_string += std::to_string(dist);
+                        }
+                    }
+
+                    result_string += '\n';
+                    synced_out->write(result_string, filename, q);
+
+                    // bases are only read for the first group
+                    thread_metrics.query_done((g == 0) ? workspace.bases : 0, hashes.size() * counters.size(),
+                                              query_start);
+                }
+            }
+        };
+
+        do_parallel_dynamic(worker, number_of_queries, options.threads, 1, [&] () { synced_out->abort(); });
+        synced_out->close();
+    }
+
+    if (keep_sketches)
+    {
+        std::cerr << "Joining the columns..." << std::endl;
+        join_columns(parts, options.output_file);
+
+        for (auto const & part : parts)
+            std::filesystem::remove(part);
+    }
+}
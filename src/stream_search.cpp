@@ -0,0 +1,389 @@
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <optional>
+
+#include <seqan3/io/sequence_file/input.hpp>
+
+#include <raptor/argument_parsing/search_arguments.hpp>
+#include <raptor/search/load_index.hpp>
+
+#include "checkpoint.hpp"
+#include "compute_distance.hpp"
+#include "index_info.hpp"
+#include "metrics.hpp"
+#include "multi_k_search.hpp"
+#include "options.hpp"
+#include "sketch_file.hpp"
+#include "stream_search.hpp"
+
+// One sample. A sample of several records is sketched as its records are read, so a sample of any size takes the
+// memory of its sketch. A sample of a single record (--per-record, --stream-group record) keeps the record and is
+// sketched by the worker that searches it.
+struct stream_sample
+{
+    std::string name{};
+    std::vector<seqan3::dna4> sequence{};
+    std::vector<uint64_t> hashes{};
+    uint64_t bases{};
+};
+
+// Consecutive samples that are searched by one worker and written as one row block. Short samples (single contigs or
+// plasmids) are collected until the batch holds `batch_bases` bases, so the queue and the output are not touched for
+// every record.
+struct sample_batch
+{
+    size_t index{};
+    size_t bases{};
+    std::vector<stream_sample> samples{};
+};
+
+static constexpr size_t batch_bases{1ULL << 20};
+
+// Batches from the reading thread to the workers. At most `capacity` batches wait, so memory stays bounded when the
+// input is read faster than it is searched.
+class batch_queue
+{
+public:
+    explicit batch_queue(size_t const capacity) : capacity{capacity}
+    {}
+
+    // batches pushed after close() are dropped
+    void push(sample_batch && batch)
+    {
+        std::unique_lock<std::mutex> lock{mutex};
+        not_full.wait(lock, [&] () { return batches.size() < capacity || closed; });
+
+        if (closed)
+            return;
+
+        batches.push_back(std::move(batch));
+        not_empty.notify_one();
+    }
+
+    // false if the queue is closed and all batches are taken
+    bool pop(sample_batch & batch)
+    {
+        std::unique_lock<std::mutex> lock{mutex};
+        not_empty.wait(lock, [&] () { return !batches.empty() || closed; });
+
+        if (batches.empty())
+            return false;
+
+        batch = std::move(batches.front());
+        batches.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+
+    size_t size()
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        return batches.size();
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        closed = true;
+        not_empty.notify_all();
+        not_full.notify_all();
+    }
+
+private:
+    size_t capacity{};
+    bool closed{false};
+    std::deque<sample_batch> batches{};
+    std::mutex mutex{};
+    std::condition_variable not_empty{};
+    std::condition_variable not_full{};
+};
+
+// Groups the records of one or more inputs into samples, sketches every record into the sketch of its sample and passes
+// the sketches in batches to the workers. Single record samples are passed unsketched.
+// With the group "record" every record is a sample named [<source>:]<id up to the first whitespace>; otherwise a sample
+// is a run of consecutive records with the same name (see --stream-group).
+class sample_reader
+{
+public:
+    sample_reader(smash_options const & options, std::string group, batch_queue & queue) :
+        options{options},
+        group{std::move(group)},
+        queue{queue}
+    {}
+
+    // reads all records of `stream` (FASTA or FASTQ, detected from the first character), `source` names the input
+    void read(std::istream & stream, std::string const & source)
+    {
+        stream >> std::ws;
+        if (stream.peek() == '@')
+            read_records(seqan3::sequence_file_input<my_traits>{stream, seqan3::format_fastq{}}, source);
+        else
+            read_records(seqan3::sequence_file_input<my_traits>{stream, seqan3::format_fasta{}}, source);
+    }
+
+    // reads all records of a file in any format (and compression) seqan3 detects from its extension
+    void read(std::string const & filename)
+    {
+        read_records(seqan3::sequence_file_input<my_traits>{filename}, filename);
+    }
+
+    // pushes the last batch and closes the queue
+    void finish()
+    {
+        finish_sample();
+        if (!batch.samples.empty())
+            queue.push(std::move(batch));
+        queue.close();
+    }
+
+private:
+    std::string sample_name(std::string const & id, std::string const & source) const
+    {
+        if (group == "record")
+        {
+            std::string name = id.substr(0, id.find_first_of(" \t"));
+            return source.empty() ? name : source + ':' + name;
+        }
+        if (group == "prefix")
+            return id.substr(0, id.find(options.stream_separator));
+
+        return "sample" + std::to_string(records / std::max<uint64_t>(options.stream_records, 1));
+    }
+
+    template <typename file_t>
+    void read_records(file_t && fin, std::string const & source)
+    {
+        for (auto && rec : fin)
+        {
+            std::string name = sample_name(rec.id(), source);
+            ++records;
+
+            if (group == "record")
+            {
+                size_t const bases = rec.sequence().size();
+                batch.bases += bases;
+                batch.samples.push_back(stream_sample{.name = std::move(name),
+                                                      .sequence = std::move(rec.sequence()),
+                                                      .bases = bases});
+                push_full_batch();
+                continue;
+            }
+
+            if (name != current_sample)
+            {
+                finish_sample();
+                start_sketch(options, workspace);
+                current_sample = std::move(name);
+            }
+
+            batch.bases += rec.sequence().size();
+            sketch_sequence(rec.sequence(), options, workspace);
+        }
+    }
+
+    void finish_sample()
+    {
+        if (!current_sample)
+            return;
+
+        finish_sketch(options, workspace);
+        batch.samples.push_back(stream_sample{.name = std::move(*current_sample),
+                                              .hashes = workspace.hashes,
+                                              .bases = workspace.bases});
+        current_sample.reset();
+        push_full_batch();
+    }
+
+    void push_full_batch()
+    {
+        if (batch.bases >= batch_bases)
+        {
+            size_t const index = batch.index + 1;
+            queue.push(std::move(batch));
+            batch = sample_batch{.index = index};
+        }
+    }
+
+    smash_options const & options;
+    std::string group{};
+    batch_queue & queue;
+
+    size_t records{0};
+    std::optional<std::string> current_sample{}; // the sample sketched in `workspace`
+    sketch_workspace workspace{};
+    sample_batch batch{};
+};
+
+// Searches the samples that read_input(reader) reads on the calling thread and writes the rows of every batch as soon
+// as it is done. The size of a sample is estimated from its sketch, the input is read only once.
+template <typename read_input_t>
+void search_samples(smash_options const & options, std::string const & group, read_input_t && read_input)
+{
+    if (options.min_abundance > 1 || options.early_stop > 0 || options.sketch_error > 0.0 ||
+        options.cluster_threshold > 0.0 || !options.kmer_sizes.empty())
+        throw std::runtime_error{"--stream and --per-record do not support --min-abundance, --early-stop, "
+                                 "--adaptive-error, --cluster-threshold and --kmer-sizes."};
+
+    raptor::raptor_index<raptor::index_structure::hibf> index{};
+    raptor::search_arguments arguments{.index_file = options.index_file,
+                                       .out_file = options.output_file};
+    raptor::load_index(index, arguments);
+
+    std::vector<uint64_t> const bin_sizes = user_bin_sizes(index, options.index_file, options.kmer_size, options);
+
+    checkpointed_out synced_out{options.output_file,
+                                std::chrono::seconds{0},
+                                false,
+                                options.ordered,
+                                options.threads * 4u};
+
+    { // write header line
+        std::string line{"#filenames"};
+        for (auto const & name : bin_references(index.bin_path(), read_index_info(options.index_file)))
+        {
+            line += '\t';
+            line += name;
+            line += ';';
+        }
+        line += '\n';
+        synced_out.write(line);
+    }
+
+    batch_queue queue{options.threads * 2u};
+
+    // the number of samples is not known in advance
+    job_metrics metrics{options.metrics_file, options.progress, std::chrono::seconds{options.metrics_interval}, 0};
+    metrics.add_gauge("smash_input_queue_batches", "Batches of samples read but not yet searched.",
+                      [&] () { return queue.size(); });
+    metrics.add_gauge("smash_output_queue_rows", "Row blocks waiting to be written.",
+                      [&] () { return synced_out.queued_rows(); });
+
+    auto search_batches = [&] ()
+    {
+        auto counter = index.ibf().template counting_agent<uint32_t>();
+        thread_counters & thread_metrics = metrics.register_thread();
+        sketch_workspace workspace{};
+        sample_batch batch{};
+        std::string result_string{};
+
+        while (queue.pop(batch))
+        {
+            result_string.clear();
+
+            for (auto const & sample : batch.samples)
+            {
+                auto const sample_start = std::chrono::steady_clock::now();
+
+                bool const unsketched = !sample.sequence.empty();
+                if (unsketched)
+                {
+                    start_sketch(options, workspace);
+                    sketch_sequence(sample.sequence, options, workspace);
+                    finish_sketch(options, workspace);
+                }
+                std::vector<uint64_t> const & hashes = unsketched ? workspace.hashes : sample.hashes;
+
+                uint64_t const sketch_size = sampled_hashes(hashes, options.scale, options.sketch_size);
+                uint64_t const query_size =
+                    sketch_cardinality(hashes, options.kmer_size, options.scale, options.sketch_size);
+
+                auto & result = counter.bulk_count(hashes);
+
+                result_string += sample.name;
+
+                for (size_t i = 0; i < result.size(); ++i)
+                {
+                    result_string += '\t';
+                    result_string += std::to_string(compute_distance(result[i],
+                                                                     sketch_size,
+                                                                     options.fpr,
+                                                                     query_size,
+                                                                     bin_sizes[i]));
+                }
+
+                result_string += '\n';
+                thread_metrics.query_done(sample.bases, hashes.size(), sample_start);
+            }
+
+            synced_out.write(result_string, std::string{}, batch.index);
+        }
+    };
+
+    auto worker = [&] ()
+    {
+        try
+        {
+            search_batches();
+        }
+        catch (...)
+        {
+            queue.close(); // stop the reader, the error is rethrown below
+            synced_out.abort(); // release workers waiting for the rows of this batch
+            throw;
+        }
+    };
+
+    std::vector<std::future<void>> tasks{};
+    for (size_t i = 0; i < std::max<size_t>(options.threads, 1); ++i)
+        tasks.emplace_back(std::async(std::launch::async, worker));
+
+    try
+    {
+        sample_reader reader{options, group, queue};
+        read_input(reader);
+        reader.finish();
+    }
+    catch (...)
+    {
+        queue.close(); // let the workers finish before the error leaves this function
+        for (auto && task : tasks)
+            task.wait();
+        throw;
+    }
+
+    for (auto && task : tasks)
+        task.get();
+
+    synced_out.close();
+}
+
+// Searches samples read from standard input or a named pipe.
+void stream_search(smash_options const & options)
+{
+    std::cerr << "Reading samples from " << ((options.stream == "-") ? "standard input" : options.stream) << "..."
+              << std::endl;
+
+    search_samples(options, options.stream_group, [&] (sample_reader & reader)
+    {
+        if (options.stream == "-")
+        {
+            reader.read(std::cin, std::string{});
+        }
+        else
+        {
+            std::ifstream stream{options.stream}; // also a named pipe
+            if (!stream.good())
+                throw std::runtime_error{"Could not open file " + options.stream};
+            reader.read(stream, std::string{});
+        }
+    });
+}
+
+// Searches every record of the --input files as a query of its own, e.g. the contigs of an assembly. One thread
+// parses the files one after the other, the workers sketch and count batches of records.
+void per_record_search(smash_options const & options)
+{
+    if (std::ranges::any_of(options.files, is_sketch_file))
+        throw std::runtime_error{"--per-record does not support precomputed sketches."};
+
+    search_samples(options, "record", [&] (sample_reader & reader)
+    {
+        for (auto const & filename : options.files)
+            reader.read(filename);
+    });
+}
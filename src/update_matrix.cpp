@@ -0,0 +1,140 @@
+#include <filesystem>
+#include <iostream>
+
+#include <robin_hood.h>
+
+#include "matrix_io.hpp"
+#include "search.hpp"
+#include "update_matrix.hpp"
+#include "options.hpp"
+
+// Runs `search()` for `files` against `index_file` into a temporary file and reads the result back.
+distance_matrix search_into_matrix(smash_options const & options,
+                                   std::vector<std::string> const & files,
+                                   std::filesystem::path const & index_file,
+                                   std::string const & suffix)
+{
+    smash_options sub_options = options;
+    sub_options.files = files;
+    sub_options.index_file = index_file;
+    sub_options.output_file = options.output_file.string() + suffix;
+    sub_options.sizes.clear();
+    sub_options.checkpoint_interval = 0;
+    sub_options.resume = false;
+
+    search(sub_options);
+
+    distance_matrix result = read_matrix(sub_options.output_file);
+    std::filesystem::remove(sub_options.output_file);
+    return result;
+}
+
+robin_hood::unordered_map<std::string, size_t> name_to_index(std::vector<std::string> const & names)
+{
+    robin_hood::unordered_map<std::string, size_t> result{};
+    for (size_t i = 0; i < names.size(); ++i)
+        result.emplace(names[i], i);
+    return result;
+}
+
+/* Given an existing matrix (rows = old queries, columns = old references),
+ * - all queries (old and new) are searched against the supplementary index (`--index`) of new references and
+ * - only the new queries are searched against the index of the old references (`--base-index`).
+ * Cells of old queries against old references are taken from the existing matrix and are never recomputed.
+ */
+void update_matrix(smash_options const & options)
+{
+    std::cerr << "Reading existing matrix..." << std::endl;
+    distance_matrix const old_matrix = read_matrix(options.matrix_file);
+
+    auto const old_rows = name_to_index(old_matrix.row_names);
+    auto const old_columns = name_to_index(old_matrix.column_names);
+
+    std::vector<std::string> new_queries{};
+    for (auto const & filename : options.files)
+        if (old_rows.count(filename) == 0)
+            new_queries.push_back(filename);
+
+    std::vector<std::string> all_queries = old_matrix.row_names;
+    all_queries.insert(all_queries.end(), new_queries.begin(), new_queries.end());
+
+    distance_matrix new_columns{};
+    if (!options.index_file.empty())
+    {
+        std::cerr << "Searching " << all_queries.size() << " queries against the supplementary index..." << std::endl;
+        new_columns = search_into_matrix(options, all_queries, options.index_file, ".new_columns.tmp");
+    }
+
+    distance_matrix new_rows{};
+    if (!new_queries.empty())
+    {
+        if (options.base_index_file.empty())
+            throw std::runtime_error{"There are " + std::to_string(new_queries.size()) + " new queries. "
+                                     "Please provide the index of the existing references with --base-index."};
+
+        std::cerr << "Searching " << new_queries.size() << " new queries against the base index..." << std::endl;
+        new_rows = search_into_matrix(options, new_queries, options.base_index_file, ".new_rows.tmp");
+    }
+
+    std::cerr << "Merging matrices..." << std::endl;
+    distance_matrix result{};
+    result.row_names = all_queries;
+    result.column_names = old_matrix.column_names;
+
+    // references of the supplementary index that are already in the matrix are updated in place
+    std::vector<size_t> new_column_positions{};
+    for (auto const & name : new_columns.column_names)
+    {
+        if (auto it = old_columns.find(name); it != old_columns.end())
+        {
+            new_column_positions.push_back(it->second);
+        }
+        else
+        {
+            new_column_positions.push_back(result.column_names.size());
+            result.column_names.push_back(name);
+        }
+    }
+
+    result.values.resize(result.rows() * result.columns(), 0.0);
+
+    for (size_t row = 0; row < old_matrix.rows(); ++row)
+        for (size_t column = 0; column < old_matrix.columns(); ++column)
+            result.at(row, column) = old_matrix.at(row, column);
+
+    if (!new_queries.empty())
+    {
+        auto const result_rows = name_to_index(result.row_names);
+
+        std::vector<size_t> column_positions{};
+        for (auto const & name : new_rows.column_names)
+        {
+            auto it = old_columns.find(name);
+            if (it == old_columns.end())
+                throw std::runtime_error{"The base index contains " + name + " which is not a column of " +
+                                         options.matrix_file.string()};
+            column_positions.push_back(it->second);
+        }
+
+        for (size_t row = 0; row < new_rows.rows(); ++row)
+        {
+            size_t const result_row = result_rows.at(new_rows.row_names[row]);
+            for (size_t column = 0; column < new_rows.columns(); ++column)
+                result.at(result_row, column_positions[column]) = new_rows.at(row, column);
+        }
+    }
+
+    if (!options.index_file.empty())
+    {
+        auto const result_rows = name_to_index(result.row_names);
+
+        for (size_t row = 0; row < new_columns.rows(); ++row)
+        {
+            size_t const result_row = result_rows.at(new_columns.row_names[row]);
+            for (size_t column = 0; column < new_columns.columns(); ++column)
+                result.at(result_row, new_column_positions[column]) = new_columns.at(row, column);
+        }
+    }
+
+    write_matrix(result, options.output_file, options.binary_output);
+}
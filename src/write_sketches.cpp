@@ -0,0 +1,134 @@
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+#include <seqan3/argument_parser/all.hpp>
+
+#include <chopper/sketch/execute.hpp>
+#include <chopper/sketch/estimate_kmer_counts.hpp>
+#include <chopper/sketch/hyperloglog.hpp>
+
+#include <raptor/search/do_parallel.hpp>
+
+#include <robin_hood.h>
+
+#include "options.hpp"
+#include "sketch_file.hpp"
+#include "sketch_io.hpp"
+
+struct write_sketches_options
+{
+    std::filesystem::path input_file{};
+    std::filesystem::path output_directory{};
+    uint32_t sketch_size{10000};
+    uint64_t scale{0};
+    uint8_t kmer_size{32};
+    uint8_t threads{1};
+};
+
+int parse_command_line(write_sketches_options & options, int const argc, char const * const * argv)
+{
+    seqan3::argument_parser parser{"write_sketches", argc, argv};
+
+    // Parser
+    parser.info.author = "SeqAn-Team"; // give parser some infos
+    parser.info.version = "1.0.0";
+    parser.add_option(options.input_file, 'i', "input", "Please provide a file with one line one file each.");
+    parser.add_option(options.output_directory, 'o', "output", "The directory for the sketches. The sketch of "
+                      "<file> is written to <output>/<filename of file>.sketch.");
+    parser.add_option(options.kmer_size, 'k', "kmer-size", "The kmer size.");
+    parser.add_option(options.sketch_size, 's', "sketch-size", "The sketch size. Larger sketches can also be used for "
+                      "searches with a smaller --sketch-size.", seqan3::option_spec::standard,
+                      seqan3::arithmetic_range_validator{1, std::numeric_limits<uint32_t>::max()});
+    parser.add_option(options.scale, '\0', "scaled", "Write FracMinHash sketches with this scale instead. They can "
+                      "be used for searches with a larger or equal --scaled, or as bottom-k sketches.");
+    parser.add_option(options.threads, 't', "threads", "The number of threads to use.");
+
+    try
+    {
+        parser.parse();                                                  // trigger command line parsing
+    }
+    catch (seqan3::argument_parser_error const & ext)                     // catch user errors
+    {
+        std::cerr << "Parsing error. " << ext.what() << "\n"; // give error message
+        return -1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char ** argv)
+{
+    write_sketches_options options{};
+    if (parse_command_line(options, argc, argv) != 0)
+        return -1;
+
+    smash_options sketch_options{.input_file = options.input_file,
+                                 .sketch_size = options.sketch_size,
+                                 .scale = options.scale,
+                                 .kmer_size = options.kmer_size,
+                                 .threads = options.threads};
+
+    {
+        std::ifstream file_in{options.input_file};
+        if (!file_in.good())
+            throw std::runtime_error{"Could not open file " + options.input_file.string()};
+
+        std::string line;
+        while (std::getline(file_in, line))
+            if (!line.empty() && line[0] != '#')
+                sketch_options.files.push_back(line.substr(0, line.find('\t')));
+    }
+
+    // the sketches are named by the file names only, two inputs must not write the same sketch
+    robin_hood::unordered_map<std::string, std::string> input_of{};
+    for (auto const & file : sketch_options.files)
+    {
+        std::string const sketch_name = std::filesystem::path{file}.filename().string() + sketch_extension;
+        auto const [it, inserted] = input_of.emplace(sketch_name, file);
+        if (!inserted)
+            throw std::runtime_error{"The sketches of " + it->second + " and " + file + " would both be written to " +
+                                     (options.output_directory / sketch_name).string() + ". Please sketch files with "
+                                     "the same name into different directories."};
+    }
+
+    std::filesystem::create_directories(options.output_directory);
+
+    std::cerr << "Estimating k-mer counts..." << std::endl;
+    std::vector<size_t> kmer_counts{};
+    {
+        std::vector<chopper::sketch::hyperloglog> sketches{};
+        chopper::configuration config{.data_file = options.input_file,
+                                      .k = options.kmer_size,
+                                      .disable_sketch_output = true,
+                                      .threads = options.threads};
+
+        chopper::sketch::execute(config, sketch_options.files, sketches);
+        chopper::sketch::estimate_kmer_counts(sketches, kmer_counts);
+    }
+
+    std::cerr << "Writing sketches..." << std::endl;
+    auto worker = [&](size_t const start, size_t const end)
+    {
+        sketch_workspace workspace{};
+
+        for (size_t i = start; i < end; ++i)
+        {
+            std::filesystem::path const filename{sketch_options.files[i]};
+            sketch_file(filename, sketch_options, workspace);
+
+            sketch_header const header{.kmer_size = options.kmer_size,
+                                       .scale = options.scale,
+                                       .sketch_size = (options.scale > 0) ? 0 : options.sketch_size,
+                                       .kmer_count = kmer_counts[i]};
+
+            write_sketch(options.output_directory / (filename.filename().string() + sketch_extension),
+                         header,
+                         workspace.hashes);
+        }
+    };
+
+    raptor::do_parallel(worker, sketch_options.files.size(), options.threads);
+
+    return 0;
+}
@@ -0,0 +1,147 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <sstream>
+#include <string>
+
+#include "checkpoint.hpp"
+#include "parallel.hpp"
+
+std::string read_file(std::filesystem::path const & filename)
+{
+    std::ifstream fin{filename};
+    std::stringstream buffer{};
+    buffer << fin.rdbuf();
+    return buffer.str();
+}
+
+TEST(checkpoint, resume_skips_completed_queries)
+{
+    std::filesystem::path const output{OUTPUTDIR "checkpoint_resume.tsv"};
+    std::filesystem::path const checkpoint{output.string() + ".checkpoint"};
+
+    {
+        checkpointed_out out{output, std::chrono::seconds{1}, false};
+        out.write("#header\n");
+        out.write("a\t1\n", "a");
+        out.write("b\t2\n", "b");
+    }
+
+    EXPECT_EQ(read_file(checkpoint), "a\nb\n@16\n");
+
+    {
+        checkpointed_out out{output, std::chrono::seconds{1}, true};
+        EXPECT_TRUE(out.is_resumed());
+        EXPECT_TRUE(out.completed_queries().contains("a"));
+        EXPECT_TRUE(out.completed_queries().contains("b"));
+        out.write("c\t3\n", "c");
+    }
+
+    EXPECT_EQ(read_file(output), "#header\na\t1\nb\t2\nc\t3\n");
+}
+
+TEST(checkpoint, fresh_run_removes_old_checkpoint)
+{
+    std::filesystem::path const output{OUTPUTDIR "checkpoint_fresh.tsv"};
+    std::filesystem::path const checkpoint{output.string() + ".checkpoint"};
+
+    {
+        checkpointed_out out{output, std::chrono::seconds{1}, false};
+        out.write("#header\n");
+        out.write("a\t1\n", "a");
+    }
+    ASSERT_TRUE(std::filesystem::exists(checkpoint));
+
+    // a run without checkpointing must not leave the checkpoint of the first run to a later --resume
+    {
+        checkpointed_out out{output, std::chrono::seconds{0}, false};
+        out.write("#header\n");
+        out.write("b\t2\n", "b");
+    }
+    EXPECT_FALSE(std::filesystem::exists(checkpoint));
+
+    // without a checkpoint, resuming must not overwrite an output that may be complete
+    EXPECT_THROW((checkpointed_out{output, std::chrono::seconds{1}, true}), std::runtime_error);
+    EXPECT_EQ(read_file(output), "#header\nb\t2\n");
+}
+
+TEST(checkpoint, resume_without_output_starts_fresh)
+{
+    std::filesystem::path const output{OUTPUTDIR "checkpoint_resume_fresh.tsv"};
+    std::filesystem::remove(output);
+    std::filesystem::remove(output.string() + ".checkpoint");
+
+    {
+        checkpointed_out out{output, std::chrono::seconds{1}, true};
+        EXPECT_FALSE(out.is_resumed());
+        EXPECT_TRUE(out.completed_queries().empty());
+        out.write("#header\n");
+    }
+
+    EXPECT_EQ(read_file(output), "#header\n");
+}
+
+TEST(checkpoint, ordered_rows)
+{
+    std::filesystem::path const output{OUTPUTDIR "checkpoint_ordered.tsv"};
+
+    {
+        checkpointed_out out{output, std::chrono::seconds{0}, false, true, 2};
+        out.write("#header\n");
+        out.write("b\n", "b", 1);
+        out.write("a\n", "a", 0);
+        out.write("c\n", "c", 2);
+        out.close();
+    }
+
+    EXPECT_EQ(read_file(output), "#header\na\nb\nc\n");
+}
+
+TEST(checkpoint, close_reports_write_errors)
+{
+    if (!std::filesystem::exists("/dev/full"))
+        GTEST_SKIP() << "needs /dev/full";
+
+    checkpointed_out out{"/dev/full", std::chrono::seconds{0}, false};
+    out.write("a row that does not fit\n", "a");
+    EXPECT_THROW(out.close(), std::runtime_error);
+}
+
+TEST(checkpoint, abort_releases_waiting_writers)
+{
+    std::filesystem::path const output{OUTPUTDIR "checkpoint_abort.tsv"};
+    checkpointed_out out{output, std::chrono::seconds{0}, false, true, 1};
+
+    // row 0 is never written, so the row with index 1 waits until abort()
+    auto waiting = std::async(std::launch::async, [&] () { out.write("b\n", "b", 1); });
+    EXPECT_EQ(waiting.wait_for(std::chrono::milliseconds{100}), std::future_status::timeout);
+
+    out.abort();
+    EXPECT_THROW(waiting.get(), std::runtime_error);
+    EXPECT_THROW(out.write("c\n", "c"), std::runtime_error);
+}
+
+TEST(checkpoint, failing_worker_does_not_block_ordered_output)
+{
+    std::filesystem::path const output{OUTPUTDIR "checkpoint_failing_worker.tsv"};
+    checkpointed_out out{output, std::chrono::seconds{0}, false, true, 4};
+
+    auto worker = [&] (chunk_queue & chunks)
+    {
+        size_t start{};
+        size_t end{};
+        while (chunks.pop(start, end))
+        {
+            for (size_t q = start; q < end; ++q)
+            {
+                if (q == 10)
+                    throw std::runtime_error{"query 10 failed"};
+                out.write(std::to_string(q) + '\n', std::to_string(q), q);
+            }
+        }
+    };
+
+    EXPECT_THROW(do_parallel_dynamic(worker, 1000, 4, 1, [&] () { out.abort(); }), std::runtime_error);
+}
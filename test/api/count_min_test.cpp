@@ -0,0 +1,55 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "count_min.hpp"
+
+TEST(count_min, exact_without_collisions)
+{
+    count_min_sketch counts{};
+    counts.reset(1ULL << 20);
+
+    for (uint8_t expected = 1; expected <= 5; ++expected)
+        for (uint64_t const hash : {3ULL, 0x123456789ULL, 0xFFFFFFFFFFFFFFFFULL})
+            EXPECT_EQ(counts.add(hash), expected);
+}
+
+TEST(count_min, never_below_the_true_count)
+{
+    count_min_sketch counts{};
+    counts.reset(256); // 64 counters per row for 1000 hashes
+
+    std::vector<uint8_t> truth(1000);
+    for (size_t round = 0; round < 3; ++round)
+    {
+        for (uint64_t hash = 0; hash < truth.size(); ++hash)
+        {
+            uint8_t const estimate = counts.add(hash * 0x9E3779B97F4A7C15ULL);
+            EXPECT_GE(estimate, ++truth[hash]);
+        }
+    }
+}
+
+TEST(count_min, saturates)
+{
+    count_min_sketch counts{};
+    counts.reset(1ULL << 10);
+
+    for (size_t i = 1; i < 255; ++i)
+        counts.add(42);
+    EXPECT_EQ(counts.add(42), 255);
+    EXPECT_EQ(counts.add(42), 255);
+}
+
+TEST(count_min, reset_clears_counts)
+{
+    count_min_sketch counts{};
+
+    for (size_t const memory : {1ULL << 20, 1ULL << 20, 1ULL << 12, 1ULL << 16})
+    {
+        counts.reset(memory);
+        EXPECT_EQ(counts.add(7), 1) << memory;
+        EXPECT_EQ(counts.add(7), 2) << memory;
+    }
+}
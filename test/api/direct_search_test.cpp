@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "direct_search.hpp"
+
+// Jaccard of the bottom-`sketch_size` hashes of the union (all hashes if sketch_size == 0), computed with sets
+double naive_jaccard(std::set<uint64_t> const & a, std::set<uint64_t> const & b, uint64_t const sketch_size)
+{
+    std::set<uint64_t> all{a};
+    all.insert(b.begin(), b.end());
+
+    uint64_t shared{0};
+    uint64_t union_size{0};
+    for (uint64_t const hash : all)
+    {
+        if (sketch_size > 0 && union_size == sketch_size)
+            break;
+
+        shared += a.contains(hash) && b.contains(hash);
+        ++union_size;
+    }
+
+    return (union_size == 0) ? 0.0 : static_cast<double>(shared) / static_cast<double>(union_size);
+}
+
+std::set<uint64_t> random_set(std::mt19937_64 & engine, size_t const size, uint64_t const max)
+{
+    std::uniform_int_distribution<uint64_t> distribution{0, max};
+    std::set<uint64_t> result{};
+    while (result.size() < size)
+        result.insert(distribution(engine));
+    return result;
+}
+
+TEST(sketch_jaccard, against_naive)
+{
+    std::mt19937_64 engine{42};
+
+    for (size_t round = 0; round < 200; ++round)
+    {
+        // a small hash range, such that the sketches share hashes
+        std::set<uint64_t> const a = random_set(engine, round % 50, 100);
+        std::set<uint64_t> const b = random_set(engine, (round * 7) % 60, 100);
+        std::vector<uint64_t> const va(a.begin(), a.end());
+        std::vector<uint64_t> const vb(b.begin(), b.end());
+
+        for (uint64_t const sketch_size : {0u, 1u, 10u, 40u, 1000u})
+        {
+            EXPECT_DOUBLE_EQ(sketch_jaccard(va, vb, sketch_size), naive_jaccard(a, b, sketch_size))
+                << "round " << round << ", sketch size " << sketch_size;
+        }
+    }
+}
+
+TEST(sketch_jaccard, identical_and_disjoint)
+{
+    std::vector<uint64_t> const a{1, 2, 3, 4};
+    std::vector<uint64_t> const b{5, 6, 7};
+
+    EXPECT_DOUBLE_EQ(sketch_jaccard(a, a, 0), 1.0);
+    EXPECT_DOUBLE_EQ(sketch_jaccard(a, a, 2), 1.0);
+    EXPECT_DOUBLE_EQ(sketch_jaccard(a, b, 0), 0.0);
+    EXPECT_DOUBLE_EQ(sketch_jaccard({}, {}, 0), 0.0);
+}
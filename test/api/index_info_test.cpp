@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "index_info.hpp"
+
+index_info scaled_info()
+{
+    index_info info{.kmer_size = 19, .scale = 100, .fpr = 0.05};
+    info.bin_paths = {"index_hashes/0_a.fa.minimiser", "index_hashes/1_b.fa.minimiser"};
+    info.references = {"genomes/a.fa", "other/b.fa"};
+    info.sizes = {1000, 2000};
+    return info;
+}
+
+TEST(index_info, round_trip)
+{
+    std::filesystem::path const index_file{OUTPUTDIR "index_info_round_trip.hibf"};
+    index_info const info = scaled_info();
+
+    write_index_info(index_file, info);
+    std::optional<index_info> const read = read_index_info(index_file);
+
+    ASSERT_TRUE(read);
+    EXPECT_EQ(read->kmer_size, info.kmer_size);
+    EXPECT_EQ(read->scale, info.scale);
+    EXPECT_DOUBLE_EQ(read->fpr, info.fpr);
+    EXPECT_EQ(read->bin_paths, info.bin_paths);
+    EXPECT_EQ(read->references, info.references);
+    EXPECT_EQ(read->sizes, info.sizes);
+}
+
+TEST(index_info, missing_file)
+{
+    EXPECT_FALSE(read_index_info(OUTPUTDIR "index_info_does_not_exist.hibf"));
+}
+
+TEST(index_info, bin_references)
+{
+    index_info const info = scaled_info();
+
+    // the order of the bins in the index need not be the order of the references
+    std::vector<std::vector<std::string>> const bin_paths{{info.bin_paths[1]}, {info.bin_paths[0]}};
+    EXPECT_EQ(bin_references(bin_paths, info), (std::vector<std::string>{"other/b.fa", "genomes/a.fa"}));
+
+    // an index built by raptor has no information, its bin paths are the references
+    EXPECT_EQ(bin_references(bin_paths, std::nullopt), (std::vector<std::string>{info.bin_paths[1],
+                                                                                 info.bin_paths[0]}));
+
+    std::vector<std::vector<std::string>> const unknown{{"index_hashes/2_c.fa.minimiser"}};
+    EXPECT_THROW(bin_references(unknown, info), std::runtime_error);
+
+    std::vector<std::vector<std::string>> const multi_file{{info.bin_paths[0], info.bin_paths[1]}};
+    EXPECT_THROW(bin_references(multi_file, info), std::runtime_error);
+}
+
+TEST(index_info, check_index_info)
+{
+    index_info const info = scaled_info();
+    std::filesystem::path const index_file{"index.hibf"};
+    smash_options options{};
+
+    options.scale = 100;
+    EXPECT_NO_THROW(check_index_info(info, index_file, 19, options));
+    options.scale = 200; // a larger scale samples a subset of the indexed hashes
+    EXPECT_NO_THROW(check_index_info(info, index_file, 19, options));
+    options.scale = 10;
+    EXPECT_THROW(check_index_info(info, index_file, 19, options), std::runtime_error);
+    options.scale = 0;
+    EXPECT_THROW(check_index_info(info, index_file, 19, options), std::runtime_error);
+
+    options.scale = 100;
+    EXPECT_THROW(check_index_info(info, index_file, 21, options), std::runtime_error);
+}
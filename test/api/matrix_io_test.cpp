@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "matrix_io.hpp"
+
+distance_matrix small_matrix()
+{
+    distance_matrix matrix{};
+    matrix.column_names = {"ref a.fa", "ref_b.fa", "ref_c.fa"};
+    matrix.row_names = {"q1.fa", "q2.fa"};
+    matrix.values = {0.5, 0.25, 0.0, 1.0, 0.125, 0.75};
+    return matrix;
+}
+
+void expect_equal(distance_matrix const & actual, distance_matrix const & expected)
+{
+    EXPECT_EQ(actual.column_names, expected.column_names);
+    EXPECT_EQ(actual.row_names, expected.row_names);
+    EXPECT_EQ(actual.values, expected.values);
+}
+
+TEST(matrix_io, text_round_trip)
+{
+    std::filesystem::path const filename{OUTPUTDIR "matrix_io.tsv"};
+    write_matrix(small_matrix(), filename, false);
+
+    EXPECT_FALSE(is_binary_matrix(filename));
+    expect_equal(read_matrix(filename), small_matrix());
+}
+
+TEST(matrix_io, binary_round_trip)
+{
+    std::filesystem::path const filename{OUTPUTDIR "matrix_io.bin"};
+    write_matrix(small_matrix(), filename, true);
+
+    EXPECT_TRUE(is_binary_matrix(filename));
+    expect_equal(read_matrix(filename), small_matrix());
+}
+
+TEST(matrix_io, text_format)
+{
+    std::ostringstream out{};
+    write_text_matrix(small_matrix(), out);
+    EXPECT_EQ(out.str(), "#filenames\tref a.fa;\tref_b.fa;\tref_c.fa;\n"
+                         "q1.fa\t0.500000\t0.250000\t0.000000\n"
+                         "q2.fa\t1.000000\t0.125000\t0.750000\n");
+}
+
+TEST(matrix_io, text_row_with_missing_column)
+{
+    std::istringstream in{"#filenames\ta;\tb;\nq1\t0.1\t0.2\nq2\t0.3\n"};
+    EXPECT_THROW(read_text_matrix(in), std::runtime_error);
+}
+
+TEST(matrix_io, text_malformed_value)
+{
+    for (std::string const value : {"", "abc", "0.5x", "1e999"})
+    {
+        std::istringstream in{"#filenames\ta;\tb;\nq1\t0.1\t" + value + "\n"};
+        EXPECT_THROW(read_text_matrix(in), std::runtime_error) << '"' << value << '"';
+    }
+}
+
+TEST(matrix_io, text_without_header)
+{
+    std::istringstream empty{""};
+    EXPECT_THROW(read_text_matrix(empty), std::runtime_error);
+
+    std::istringstream empty_header{"\nq1\t0.1\n"};
+    EXPECT_THROW(read_text_matrix(empty_header), std::runtime_error);
+}
+
+TEST(matrix_io, truncated_binary)
+{
+    std::ostringstream out{};
+    write_binary_matrix(small_matrix(), out);
+    std::string const content = out.str();
+
+    std::istringstream in{content.substr(0, content.size() - 8)};
+    EXPECT_THROW(read_binary_matrix(in), std::runtime_error);
+}
+
+TEST(matrix_io, wrong_magic)
+{
+    std::istringstream in{std::string(64, 'x')};
+    EXPECT_THROW(read_binary_matrix(in), std::runtime_error);
+}
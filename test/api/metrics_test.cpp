@@ -0,0 +1,61 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "checkpoint.hpp"
+#include "metrics.hpp"
+
+// Workers register and report while the reporting thread writes the file, meant to be run under ThreadSanitizer.
+TEST(metrics, concurrent_workers)
+{
+    std::filesystem::path const output{OUTPUTDIR "metrics_rows.tsv"};
+    std::filesystem::path const metrics_file{OUTPUTDIR "metrics.prom"};
+    size_t constexpr queries{1200};
+    size_t constexpr threads{4};
+
+    checkpointed_out out{output, std::chrono::seconds{0}, false, true, 64};
+    {
+        job_metrics metrics{metrics_file, false, std::chrono::seconds{1}, queries};
+        metrics.add_gauge("smash_output_queue_rows", "Rows waiting to be written.",
+                          [&] () { return out.queued_rows(); });
+
+        std::atomic<size_t> next{0};
+        std::vector<std::thread> workers{};
+        for (size_t t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([&] ()
+            {
+                thread_counters & counters = metrics.register_thread();
+                for (size_t q; (q = next++) < queries;)
+                {
+                    auto const start = std::chrono::steady_clock::now();
+                    std::this_thread::sleep_for(std::chrono::microseconds{5000});
+                    out.write("row" + std::to_string(q) + '\n', std::string{}, q);
+                    counters.query_done(1000, 100, start);
+                }
+            });
+        }
+
+        for (auto & worker : workers)
+            worker.join();
+    } // the last report is written when the metrics are destroyed
+    out.close();
+
+    std::ifstream fin{metrics_file};
+    std::stringstream buffer{};
+    buffer << fin.rdbuf();
+    std::string const content = buffer.str();
+
+    EXPECT_NE(content.find("smash_queries_done_total " + std::to_string(queries) + '\n'), std::string::npos);
+    EXPECT_NE(content.find("smash_bases_total " + std::to_string(queries * 1000) + '\n'), std::string::npos);
+    EXPECT_NE(content.find("smash_hashes_total " + std::to_string(queries * 100) + '\n'), std::string::npos);
+    EXPECT_NE(content.find("smash_output_queue_rows "), std::string::npos);
+    EXPECT_NE(content.find("smash_thread_utilisation{thread=\"3\"}"), std::string::npos);
+    EXPECT_FALSE(std::filesystem::exists(metrics_file.string() + ".tmp"));
+}
@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include "parallel.hpp"
+
+TEST(parallel, chunk_queue)
+{
+    chunk_queue chunks{10, 4};
+    size_t start{};
+    size_t end{};
+
+    ASSERT_TRUE(chunks.pop(start, end));
+    EXPECT_EQ(start, 0u);
+    EXPECT_EQ(end, 4u);
+    ASSERT_TRUE(chunks.pop(start, end));
+    EXPECT_EQ(start, 4u);
+    EXPECT_EQ(end, 8u);
+    ASSERT_TRUE(chunks.pop(start, end));
+    EXPECT_EQ(start, 8u);
+    EXPECT_EQ(end, 10u);
+    EXPECT_FALSE(chunks.pop(start, end));
+}
+
+TEST(parallel, chunk_queue_stop)
+{
+    chunk_queue chunks{10, 1};
+    size_t start{};
+    size_t end{};
+
+    ASSERT_TRUE(chunks.pop(start, end));
+    chunks.stop();
+    EXPECT_FALSE(chunks.pop(start, end));
+}
+
+TEST(parallel, every_index_once)
+{
+    std::vector<std::atomic<int>> visits(1000);
+
+    do_parallel_dynamic([&] (chunk_queue & chunks)
+    {
+        size_t start{};
+        size_t end{};
+        while (chunks.pop(start, end))
+            for (size_t i = start; i < end; ++i)
+                ++visits[i];
+    }, visits.size(), 4, 7);
+
+    for (auto const & count : visits)
+        EXPECT_EQ(count.load(), 1);
+}
+
+TEST(parallel, rethrows_and_calls_on_failure)
+{
+    std::atomic<size_t> processed{0};
+    std::atomic<int> failures{0};
+
+    auto worker = [&] (chunk_queue & chunks)
+    {
+        size_t start{};
+        size_t end{};
+        while (chunks.pop(start, end))
+        {
+            if (start == 5)
+                throw std::runtime_error{"failed"};
+            ++processed;
+        }
+    };
+
+    EXPECT_THROW(do_parallel_dynamic(worker, 100000, 4, 1, [&] () { ++failures; }), std::runtime_error);
+    EXPECT_EQ(failures.load(), 1);
+    EXPECT_LT(processed.load(), 100000u); // no chunks are handed out after the failure
+}
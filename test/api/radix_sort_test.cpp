@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "radix_sort.hpp"
+
+TEST(radix_sort, random_values)
+{
+    std::mt19937_64 engine{42};
+    std::vector<uint64_t> values(10000);
+    for (auto & value : values)
+        value = engine();
+
+    std::vector<uint64_t> expected = values;
+    std::ranges::sort(expected);
+
+    std::vector<uint64_t> buffer{};
+    radix_sort(values, buffer);
+    EXPECT_EQ(values, expected);
+}
+
+TEST(radix_sort, skipped_digits)
+{
+    // hashes of k = 15 only use the lower 30 bits, and every value has the same second byte
+    std::mt19937_64 engine{7};
+    std::vector<uint64_t> values(5000);
+    for (auto & value : values)
+        value = (engine() & 0x3FFF00FFULL) | 0xAB00ULL;
+
+    std::vector<uint64_t> expected = values;
+    std::ranges::sort(expected);
+
+    std::vector<uint64_t> buffer{};
+    radix_sort(values, buffer);
+    EXPECT_EQ(values, expected);
+}
+
+TEST(radix_sort, small_inputs)
+{
+    std::vector<uint64_t> buffer{};
+
+    std::vector<uint64_t> empty{};
+    radix_sort(empty, buffer);
+    EXPECT_TRUE(empty.empty());
+
+    std::vector<uint64_t> one{5};
+    radix_sort(one, buffer);
+    EXPECT_EQ(one, std::vector<uint64_t>{5});
+
+    std::vector<uint64_t> equal(3, 9);
+    radix_sort(equal, buffer);
+    EXPECT_EQ(equal, std::vector<uint64_t>(3, 9));
+}
+
+TEST(radix_sort, unique)
+{
+    std::vector<uint64_t> values{0xFFFFFFFFFFFFFFFFULL, 3, 1ULL << 40, 3, 0, 1ULL << 40, 0xFFFFFFFFFFFFFFFFULL, 2};
+    std::vector<uint64_t> buffer{};
+
+    radix_sort_unique(values, buffer);
+    EXPECT_EQ(values, (std::vector<uint64_t>{0, 2, 3, 1ULL << 40, 0xFFFFFFFFFFFFFFFFULL}));
+}
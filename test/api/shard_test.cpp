@@ -0,0 +1,52 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "shard.hpp"
+
+TEST(select_shard, by_index)
+{
+    std::vector<std::string> const files{"a", "b", "c", "d", "e"};
+
+    EXPECT_EQ(select_shard(files, 0, 2, "index"), (std::vector<std::string>{"a", "b"}));
+    EXPECT_EQ(select_shard(files, 1, 2, "index"), (std::vector<std::string>{"c", "d", "e"}));
+    EXPECT_EQ(select_shard(files, 0, 1, "index"), files);
+
+    // more shards than files: some shards are empty, every file is in one shard
+    std::vector<std::string> all{};
+    for (size_t shard = 0; shard < 7; ++shard)
+        for (auto const & file : select_shard(files, shard, 7, "index"))
+            all.push_back(file);
+    EXPECT_EQ(all, files);
+}
+
+TEST(select_shard, by_size)
+{
+    std::filesystem::path const directory{OUTPUTDIR "select_shard_by_size"};
+    std::filesystem::create_directories(directory);
+
+    std::vector<std::string> files{};
+    for (size_t const size : {100u, 10u, 60u, 50u, 30u})
+    {
+        files.push_back((directory / ("file" + std::to_string(size))).string());
+        std::ofstream{files.back()} << std::string(size, 'A');
+    }
+
+    // largest first, each to the shard with the smallest total: 100 -> 0, 60 -> 1, 50 -> 1, 30 -> 0, 10 -> 1
+    // the files keep their order within a shard
+    EXPECT_EQ(select_shard(files, 0, 2, "size"), (std::vector<std::string>{files[0], files[4]}));
+    EXPECT_EQ(select_shard(files, 1, 2, "size"), (std::vector<std::string>{files[1], files[2], files[3]}));
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST(select_shard, invalid_shard)
+{
+    std::vector<std::string> const files{"a", "b"};
+
+    EXPECT_THROW(select_shard(files, 2, 2, "index"), std::runtime_error);
+    EXPECT_THROW(select_shard(files, 0, 0, "index"), std::runtime_error);
+}
@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "sketch_file.hpp"
+#include "sketch_io.hpp"
+
+std::filesystem::path const bottom_k_file{OUTPUTDIR "sketch_io_bottom_k.sketch"};
+std::filesystem::path const scaled_file{OUTPUTDIR "sketch_io_scaled.sketch"};
+
+std::vector<uint64_t> const bottom_k_hashes{1, 5, 9, 20, 33, 47};
+std::vector<uint64_t> const scaled_hashes{2, 100, 1000, 100000, 10000000}; // k = 15: max hash 2^30 - 1
+
+class sketch_io : public ::testing::Test
+{
+protected:
+    static void SetUpTestSuite()
+    {
+        write_sketch(bottom_k_file,
+                     sketch_header{.kmer_size = 15, .scale = 0, .sketch_size = 6, .kmer_count = 1234},
+                     bottom_k_hashes);
+        write_sketch(scaled_file,
+                     sketch_header{.kmer_size = 15, .scale = 100, .sketch_size = 0, .kmer_count = 5678},
+                     scaled_hashes);
+    }
+};
+
+TEST_F(sketch_io, round_trip)
+{
+    EXPECT_TRUE(is_sketch_file(bottom_k_file));
+    EXPECT_FALSE(is_sketch_file(OUTPUTDIR "genome.fa"));
+
+    std::vector<uint64_t> hashes{};
+    sketch_header const header = read_sketch(bottom_k_file, hashes);
+    EXPECT_EQ(hashes, bottom_k_hashes);
+    EXPECT_EQ(header.kmer_size, 15u);
+    EXPECT_EQ(header.scale, 0u);
+    EXPECT_EQ(header.sketch_size, 6u);
+    EXPECT_EQ(header.kmer_count, 1234u);
+    EXPECT_EQ(header.number_of_hashes, bottom_k_hashes.size());
+
+    EXPECT_EQ(read_sketch_header(scaled_file).kmer_count, 5678u);
+}
+
+TEST_F(sketch_io, truncated)
+{
+    std::filesystem::path const truncated{OUTPUTDIR "sketch_io_truncated.sketch"};
+    std::filesystem::copy_file(bottom_k_file, truncated, std::filesystem::copy_options::overwrite_existing);
+    std::filesystem::resize_file(truncated, std::filesystem::file_size(truncated) - 4);
+
+    std::vector<uint64_t> hashes{};
+    EXPECT_NO_THROW(read_sketch_header(truncated));
+    EXPECT_THROW(read_sketch(truncated, hashes), std::runtime_error);
+}
+
+TEST_F(sketch_io, not_a_sketch)
+{
+    std::filesystem::path const filename{OUTPUTDIR "sketch_io_text.sketch"};
+    std::ofstream{filename} << ">not a sketch\nACGT\n";
+
+    EXPECT_THROW(read_sketch_header(filename), std::runtime_error);
+}
+
+TEST_F(sketch_io, precomputed_bottom_k)
+{
+    smash_options options{};
+    options.kmer_size = 15;
+    std::vector<uint64_t> hashes{};
+
+    read_precomputed_sketch(bottom_k_file, options, hashes, 4);
+    EXPECT_EQ(hashes, (std::vector<uint64_t>{1, 5, 9, 20}));
+
+    // the sketch is full, it cannot be extended to a larger sketch size
+    EXPECT_THROW(read_precomputed_sketch(bottom_k_file, options, hashes, 10), std::runtime_error);
+
+    // a scaled sketch serves as bottom-k sketch
+    read_precomputed_sketch(scaled_file, options, hashes, 3);
+    EXPECT_EQ(hashes, (std::vector<uint64_t>{2, 100, 1000}));
+
+    options.kmer_size = 21;
+    EXPECT_THROW(read_precomputed_sketch(bottom_k_file, options, hashes, 4), std::runtime_error);
+}
+
+TEST_F(sketch_io, precomputed_scaled)
+{
+    smash_options options{};
+    options.kmer_size = 15;
+    std::vector<uint64_t> hashes{};
+
+    // a larger scale keeps the hashes below its smaller threshold
+    options.scale = 1000;
+    read_precomputed_sketch(scaled_file, options, hashes, 0);
+    EXPECT_EQ(hashes, (std::vector<uint64_t>{2, 100, 1000, 100000}));
+
+    // a smaller scale needs hashes the sketch does not have
+    options.scale = 10;
+    EXPECT_THROW(read_precomputed_sketch(scaled_file, options, hashes, 0), std::runtime_error);
+
+    options.scale = 1000;
+    EXPECT_THROW(read_precomputed_sketch(bottom_k_file, options, hashes, 0), std::runtime_error);
+}
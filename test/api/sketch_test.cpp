@@ -0,0 +1,195 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <fstream>
+#include <set>
+#include <vector>
+
+#include <seqan3/alphabet/nucleotide/dna4.hpp>
+
+#include "sketch.hpp"
+#include "sketch_file.hpp"
+
+using seqan3::operator""_dna4;
+
+// the `sketch_size` smallest distinct hashes of `sequence`
+std::vector<uint64_t> naive_sketch(seqan3::dna4_vector const & sequence, uint32_t const sketch_size)
+{
+    std::set<uint64_t> distinct{};
+    for_each_kmer_hash(sequence, fixed_kmer_size<15>{}, [&] (uint64_t const hash) { distinct.insert(hash); });
+
+    std::vector<uint64_t> result(distinct.begin(), distinct.end());
+    result.resize(std::min<size_t>(result.size(), sketch_size));
+    return result;
+}
+
+// a read set with 20-fold coverage of a short genome
+seqan3::dna4_vector repeated_sequence()
+{
+    seqan3::dna4_vector const unit = "ACGGTCAAGTTCGATCGGATCCATGCAAGTCGTTAGCATCGGAC"_dna4;
+    seqan3::dna4_vector sequence{};
+    for (size_t i = 0; i < 20; ++i)
+        sequence.insert(sequence.end(), unit.begin(), unit.end());
+    return sequence;
+}
+
+TEST(sketch, insert_ignores_duplicates)
+{
+    my_priority_queue<uint64_t> sketch{};
+
+    EXPECT_TRUE(insert_into_sketch(5, 2, sketch));
+    EXPECT_FALSE(insert_into_sketch(5, 2, sketch));
+    EXPECT_TRUE(insert_into_sketch(7, 2, sketch));
+    EXPECT_FALSE(insert_into_sketch(5, 2, sketch)); // below the top, but already in the sketch
+    EXPECT_TRUE(insert_into_sketch(3, 2, sketch));
+    EXPECT_FALSE(insert_into_sketch(3, 2, sketch));
+
+    std::vector<uint64_t> hashes = sketch.container();
+    std::ranges::sort(hashes);
+    EXPECT_EQ(hashes, (std::vector<uint64_t>{3, 5}));
+}
+
+TEST(sketch, repeated_kmers)
+{
+    seqan3::dna4_vector const sequence = repeated_sequence();
+
+    for (uint32_t const sketch_size : {5u, 20u, 100u})
+    {
+        std::vector<uint64_t> sketch = sketch_min_hash(sequence, fixed_kmer_size<15>{}, sketch_size);
+        std::ranges::sort(sketch);
+        EXPECT_EQ(sketch, naive_sketch(sequence, sketch_size)) << "sketch size " << sketch_size;
+    }
+}
+
+TEST(sketch, repeated_kmers_over_several_records)
+{
+    seqan3::dna4_vector const sequence = repeated_sequence();
+    uint32_t const sketch_size = 10;
+
+    // fill the sketch with the first record, later records only replace hashes, as sketch_file() does for reads
+    my_priority_queue<uint64_t> sketch{};
+    init_sketch(sequence, fixed_kmer_size<15>{}, sketch_size, sketch);
+    add_to_sketch(sequence, fixed_kmer_size<15>{}, sketch);
+    add_to_sketch(sequence, fixed_kmer_size<15>{}, sketch);
+
+    std::vector<uint64_t> hashes = sketch.container();
+    std::ranges::sort(hashes);
+    EXPECT_EQ(hashes, naive_sketch(sequence, sketch_size));
+}
+
+TEST(sketch, clear_forgets_members)
+{
+    my_priority_queue<uint64_t> sketch{};
+    EXPECT_TRUE(insert_into_sketch(5, 2, sketch));
+    sketch.clear();
+    EXPECT_TRUE(insert_into_sketch(5, 2, sketch));
+    EXPECT_EQ(sketch.size(), 1u);
+}
+
+TEST(sketch, record_shorter_than_sketch)
+{
+    seqan3::dna4_vector const record = "ACGGTCAAGTTCGATCGGATCCATGCAAGT"_dna4; // 16 k-mers
+    uint32_t const sketch_size = 100;
+
+    std::vector<uint64_t> hashes = sketch_min_hash(record, fixed_kmer_size<15>{}, sketch_size);
+    std::ranges::sort(hashes);
+    ASSERT_EQ(hashes, naive_sketch(record, sketch_size));
+    ASSERT_LT(hashes.size(), sketch_size);
+
+    // a record that is completely in the index is contained with 1, not with hashes.size() / sketch_size
+    EXPECT_EQ(sampled_hashes(hashes, 0, sketch_size), hashes.size());
+    EXPECT_EQ(sketch_cardinality(hashes, 15, 0, sketch_size), hashes.size());
+
+    // a full bottom-k sketch sampled `sketch_size` hashes
+    EXPECT_EQ(sampled_hashes(hashes, 0, 4), 4u);
+    // a scaled sketch sampled all of its hashes
+    EXPECT_EQ(sampled_hashes(hashes, 1000, 4), hashes.size());
+}
+
+TEST(sketch, file_of_short_records)
+{
+    // every record has fewer k-mers than the sketch size, the sketch is filled over several records
+    std::vector<std::string> const records{"ACGGTCAAGTTCGATCGGATCCATGC", "TTGACCGATGCAAGTCGTTAGCATCGG",
+                                           "GGATCCATGCAAGTCGTTAGCATCGGAC", "CATGCAAGTCGTTAGCAACGGTCAAGTT"};
+    std::filesystem::path const filename{OUTPUTDIR "sketch_short_records.fa"};
+    seqan3::dna4_vector concatenated{};
+    {
+        std::ofstream fout{filename};
+        for (size_t i = 0; i < records.size(); ++i)
+            fout << ">r" << i << '\n' << records[i] << '\n';
+    }
+
+    smash_options options{};
+    options.kmer_size = 15;
+    options.sketch_size = 20;
+
+    std::vector<uint64_t> const sketch = sketch_file(filename, options);
+
+    std::set<uint64_t> distinct{};
+    for (auto const & record : records)
+    {
+        seqan3::dna4_vector sequence{};
+        for (char const c : record)
+            sequence.push_back(seqan3::assign_char_to(c, seqan3::dna4{}));
+        for_each_kmer_hash(sequence, fixed_kmer_size<15>{}, [&] (uint64_t const hash) { distinct.insert(hash); });
+    }
+    std::vector<uint64_t> expected(distinct.begin(), distinct.end());
+    expected.resize(options.sketch_size);
+
+    EXPECT_EQ(sketch, expected);
+}
+
+TEST(sketch, incremental_like_file)
+{
+    std::filesystem::path const filename{OUTPUTDIR "sketch_incremental.fa"};
+    {
+        std::ofstream fout{filename};
+        fout << ">r0\nACGGTCAAGTTCGATCGGATCCATGCAAGTCGTTAGCATCGGAC\n>r1\nTTGACCGATGCAAGTCGTTAGCATCGGAAC\n";
+    }
+
+    for (uint64_t const scale : {0u, 4u})
+    {
+        smash_options options{};
+        options.kmer_size = 15;
+        options.sketch_size = 10;
+        options.scale = scale;
+
+        sketch_workspace workspace{};
+        start_sketch(options, workspace);
+        for (auto && rec : seqan3::sequence_file_input<my_traits>{filename})
+            sketch_sequence(rec.sequence(), options, workspace);
+        finish_sketch(options, workspace);
+
+        EXPECT_EQ(workspace.hashes, sketch_file(filename, options)) << "scale " << scale;
+        EXPECT_EQ(workspace.bases, 74u);
+    }
+}
+
+TEST(sketch, cardinality_of_full_sketches)
+{
+    // a pseudo random genome, its k-mers are (almost) all distinct
+    seqan3::dna4_vector sequence{};
+    uint64_t seed{42};
+    for (size_t i = 0; i < 2'000'000; ++i)
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        sequence.push_back(seqan3::dna4{}.assign_rank(seed >> 62));
+    }
+
+    std::vector<uint64_t> all_hashes{};
+    for_each_kmer_hash(sequence, fixed_kmer_size<21>{}, [&] (uint64_t const hash) { all_hashes.push_back(hash); });
+    finalise_scaled_sketch(all_hashes);
+    double const cardinality = all_hashes.size();
+
+    uint32_t const sketch_size = 10000;
+    std::vector<uint64_t> bottom_k = sketch_min_hash(sequence, fixed_kmer_size<21>{}, sketch_size);
+    std::ranges::sort(bottom_k);
+    ASSERT_EQ(bottom_k.size(), sketch_size);
+    EXPECT_NEAR(sketch_cardinality(bottom_k, 21, 0, sketch_size) / cardinality, 1.0, 0.05);
+
+    uint64_t const scale = 100;
+    std::vector<uint64_t> scaled{};
+    add_to_scaled_sketch(sequence, fixed_kmer_size<21>{}, scaled_threshold(21, scale), scaled);
+    finalise_scaled_sketch(scaled);
+    EXPECT_NEAR(sketch_cardinality(scaled, 21, scale, sketch_size) / cardinality, 1.0, 0.05);
+}
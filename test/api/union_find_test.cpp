@@ -0,0 +1,50 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "union_find.hpp"
+
+TEST(union_find, smallest_element_represents_its_set)
+{
+    concurrent_union_find sets{8};
+    sets.unite(5, 7);
+    sets.unite(7, 2);
+    sets.unite(3, 4);
+
+    EXPECT_EQ(sets.find(5), 2u);
+    EXPECT_EQ(sets.find(7), 2u);
+    EXPECT_EQ(sets.find(2), 2u);
+    EXPECT_EQ(sets.find(4), 3u);
+    EXPECT_EQ(sets.find(0), 0u);
+    EXPECT_EQ(sets.find(6), 6u);
+
+    sets.unite(4, 5);
+    for (uint32_t const element : {2u, 3u, 4u, 5u, 7u})
+        EXPECT_EQ(sets.find(element), 2u);
+}
+
+// The same clusters as adding the edges on one thread, whatever the order of the edges; meant to be run under
+// ThreadSanitizer, too.
+TEST(union_find, concurrent_unite)
+{
+    size_t constexpr size{10000};
+    size_t constexpr threads{4};
+    concurrent_union_find sets{size};
+
+    // element i and i + 10 are linked, i.e. the sets are the residues modulo 10
+    std::vector<std::thread> workers{};
+    for (size_t t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t] ()
+        {
+            for (uint32_t i = t; i + 10 < size; i += threads)
+                sets.unite(i + 10, i);
+        });
+    }
+    for (auto & worker : workers)
+        worker.join();
+
+    for (uint32_t i = 0; i < size; ++i)
+        EXPECT_EQ(sets.find(i), i % 10) << i;
+}
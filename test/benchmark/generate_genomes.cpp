@@ -0,0 +1,94 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+
+#include <seqan3/argument_parser/all.hpp>
+
+// Random genome families: every family has a random root genome, every member is a copy of the root with
+// independent substitutions. Two members of a family differ at about 2 * mutation_rate of the positions.
+struct generator_options
+{
+    std::filesystem::path output_directory{};
+    size_t families{4};
+    size_t members{4};
+    size_t length{1'000'000};
+    double mutation_rate{0.01};
+    uint64_t seed{42};
+};
+
+int parse_command_line(generator_options & options, int const argc, char const * const * argv)
+{
+    seqan3::argument_parser parser{"generate_genomes", argc, argv};
+
+    // Parser
+    parser.info.author = "SeqAn-Team"; // give parser some infos
+    parser.info.version = "1.0.0";
+    parser.add_option(options.output_directory, 'o', "output", "The directory for the genomes and the list of all "
+                      "genomes (genomes.txt).", seqan3::option_spec::required);
+    parser.add_option(options.families, '\0', "families", "The number of families.");
+    parser.add_option(options.members, '\0', "members", "The number of genomes per family.");
+    parser.add_option(options.length, '\0', "length", "The length of each genome.");
+    parser.add_option(options.mutation_rate, '\0', "mutation-rate", "The substitution rate of a member relative to "
+                      "its family root.", seqan3::option_spec::standard, seqan3::arithmetic_range_validator{0, 1});
+    parser.add_option(options.seed, '\0', "seed", "The seed of the random number generator.");
+
+    try
+    {
+        parser.parse();                                                  // trigger command line parsing
+    }
+    catch (seqan3::argument_parser_error const & ext)                     // catch user errors
+    {
+        std::cerr << "Parsing error. " << ext.what() << "\n"; // give error message
+        return -1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char ** argv)
+{
+    generator_options options{};
+    if (parse_command_line(options, argc, argv) != 0)
+        return -1;
+
+    std::filesystem::create_directories(options.output_directory);
+
+    std::mt19937_64 engine{options.seed};
+    std::uniform_int_distribution<int> base_distribution{0, 3};
+    std::uniform_int_distribution<int> substitution_distribution{1, 3};
+    std::bernoulli_distribution mutate{options.mutation_rate};
+    constexpr char bases[4] = {'A', 'C', 'G', 'T'};
+
+    std::ofstream list{options.output_directory / "genomes.txt"};
+    std::string root(options.length, 'A');
+    std::string genome{};
+
+    for (size_t family = 0; family < options.families; ++family)
+    {
+        for (auto & base : root)
+            base = bases[base_distribution(engine)];
+
+        for (size_t member = 0; member < options.members; ++member)
+        {
+            genome = root;
+            for (auto & base : genome)
+                if (mutate(engine)) // a different base
+                    base = bases[(std::string_view{bases, 4}.find(base) + substitution_distribution(engine)) % 4];
+
+            std::string const name = "family" + std::to_string(family) + "_member" + std::to_string(member);
+            std::filesystem::path const filename = std::filesystem::absolute(options.output_directory / (name + ".fa"));
+
+            std::ofstream fasta{filename};
+            fasta << '>' << name << '\n';
+            for (size_t pos = 0; pos < genome.size(); pos += 80)
+                fasta << std::string_view{genome}.substr(pos, 80) << '\n';
+
+            list << filename.string() << '\n';
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,90 @@
+#!/usr/bin/env bash
+# End-to-end scaling benchmark on synthetic genome families.
+#
+# Usage: scaling_benchmark.sh <bin directory> <generate_genomes executable> <work directory>
+#
+# For every number of genomes in GENOMES: generates genome families, builds an HIBF with `smash index`, and for every number
+# of threads in THREADS runs smash with sketches and in exact mode (--disable-sketching). The sketch matrix is compared
+# to the exact one with mean_squared_error. Wall time, throughput and peak memory of every run are written to
+# <work directory>/results.tsv.
+#
+# The environment variables below change the parameters. The index is built by `smash index` rather than the raptor
+# executable, such that it is built by the raptor version smash is linked against.
+
+set -euo pipefail
+
+BIN_DIR=$(realpath "$1")
+GENERATE_GENOMES=$(realpath "$2")
+WORK_DIR=$3
+
+GENOMES=${GENOMES:-"16 64 256"}
+THREADS=${THREADS:-"1 4 16"}
+MEMBERS=${MEMBERS:-4}
+LENGTH=${LENGTH:-1000000}
+MUTATION_RATE=${MUTATION_RATE:-0.01}
+KMER_SIZE=${KMER_SIZE:-32}
+SKETCH_SIZE=${SKETCH_SIZE:-10000}
+FPR=${FPR:-0.05}
+
+mkdir -p "$WORK_DIR"
+RESULTS="$WORK_DIR/results.tsv"
+echo -e "genomes\tbins\tthreads\tmode\twall_s\tbp_per_s\tpeak_rss_kib\tsse" > "$RESULTS"
+
+# runs a command and sets MEASUREMENT to "<wall seconds>\t<peak rss KiB>"
+measure()
+{
+    local time_file
+    time_file=$(mktemp)
+    /usr/bin/time -f "%e\t%M" -o "$time_file" "$@" > /dev/null
+    MEASUREMENT=$(tail -n 1 "$time_file")
+    rm "$time_file"
+}
+
+for genomes in $GENOMES
+do
+    data_dir="$WORK_DIR/genomes_$genomes"
+    families=$(( (genomes + MEMBERS - 1) / MEMBERS ))
+
+    echo "[$genomes genomes] Generating data..."
+    "$GENERATE_GENOMES" --output "$data_dir" --families "$families" --members "$MEMBERS" --length "$LENGTH" \
+                        --mutation-rate "$MUTATION_RATE"
+
+    list="$data_dir/genomes.txt"
+    bins=$(wc -l < "$list")
+    total_bp=$(( bins * LENGTH ))
+
+    echo "[$genomes genomes] Building index..."
+    "$BIN_DIR/smash" index --input "$list" --output "$data_dir/index.hibf" --kmer-size "$KMER_SIZE" --fpr "$FPR" \
+                           --threads 16 > /dev/null
+
+    for threads in $THREADS
+    do
+        echo "[$genomes genomes, $threads threads] Running smash..."
+        sketch_matrix="$data_dir/sketch_$threads.matrix"
+        exact_matrix="$data_dir/exact_$threads.matrix"
+
+        measure "$BIN_DIR/smash" --input "$list" --index "$data_dir/index.hibf" --output "$sketch_matrix" \
+                                 --kemr-size "$KMER_SIZE" --sketch-size "$SKETCH_SIZE" --fpr "$FPR" --threads "$threads"
+        sketch_measurement=$MEASUREMENT
+
+        measure "$BIN_DIR/smash" --input "$list" --index "$data_dir/index.hibf" --output "$exact_matrix" \
+                                 --kemr-size "$KMER_SIZE" --fpr "$FPR" --threads "$threads" --disable-sketching
+        exact_measurement=$MEASUREMENT
+
+        sse=$("$BIN_DIR/mean_squared_error" --input "$sketch_matrix" --truth "$exact_matrix" | sed 's/SSE: //')
+
+        for mode in sketch exact
+        do
+            measurement=$sketch_measurement
+            [[ $mode == exact ]] && measurement=$exact_measurement
+            wall=$(cut -f 1 <<< "$measurement")
+            rss=$(cut -f 2 <<< "$measurement")
+            throughput=$(awk -v bp="$total_bp" -v s="$wall" 'BEGIN { printf "%.0f", (s > 0) ? bp / s : 0 }')
+            [[ $mode == exact ]] && mode_sse=0 || mode_sse=$sse
+
+            echo -e "$genomes\t$bins\t$threads\t$mode\t$wall\t$throughput\t$rss\t$mode_sse" >> "$RESULTS"
+        done
+    done
+done
+
+column -t "$RESULTS"
@@ -0,0 +1,110 @@
+#include <benchmark/benchmark.h>
+
+#include <random>
+
+#include <seqan3/alphabet/nucleotide/dna4.hpp>
+
+#include "sketch.hpp"
+
+static std::vector<seqan3::dna4> random_sequence(size_t const length)
+{
+    std::mt19937_64 engine{42};
+    std::uniform_int_distribution<uint8_t> distribution{0, 3};
+
+    std::vector<seqan3::dna4> sequence(length);
+    for (auto & symbol : sequence)
+        symbol.assign_rank(distribution(engine));
+    return sequence;
+}
+
+static constexpr size_t sequence_length{1'000'000};
+static constexpr uint32_t sketch_size{10'000};
+
+// k-mer size as runtime value: seqan3::views::minimiser_hash
+static void sketch_generic_k(benchmark::State & state)
+{
+    auto const sequence = random_sequence(sequence_length);
+    uint8_t const kmer_size = state.range(0);
+
+    for (auto _ : state)
+    {
+        my_priority_queue<uint64_t> sketch{};
+        init_sketch(sequence, kmer_size, sketch_size, sketch);
+        benchmark::DoNotOptimize(sketch.top());
+    }
+
+    state.counters["bp/s"] = benchmark::Counter(sequence_length, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+// k-mer size dispatched to a compile time constant
+static void sketch_fixed_k(benchmark::State & state)
+{
+    auto const sequence = random_sequence(sequence_length);
+    uint8_t const kmer_size = state.range(0);
+
+    for (auto _ : state)
+    {
+        my_priority_queue<uint64_t> sketch{};
+        with_kmer_size(kmer_size, [&] (auto const k) { init_sketch(sequence, k, sketch_size, sketch); });
+        benchmark::DoNotOptimize(sketch.top());
+    }
+
+    state.counters["bp/s"] = benchmark::Counter(sequence_length, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+static void hash_generic_k(benchmark::State & state)
+{
+    auto const sequence = random_sequence(sequence_length);
+    uint8_t const kmer_size = state.range(0);
+
+    for (auto _ : state)
+    {
+        uint64_t sum{0};
+        for_each_kmer_hash(sequence, kmer_size, [&] (uint64_t const hash) { sum += hash; });
+        benchmark::DoNotOptimize(sum);
+    }
+
+    state.counters["bp/s"] = benchmark::Counter(sequence_length, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+static void hash_fixed_k(benchmark::State & state)
+{
+    auto const sequence = random_sequence(sequence_length);
+    uint8_t const kmer_size = state.range(0);
+
+    for (auto _ : state)
+    {
+        uint64_t sum{0};
+        with_kmer_size(kmer_size, [&] (auto const k)
+        {
+            for_each_kmer_hash(sequence, k, [&] (uint64_t const hash) { sum += hash; });
+        });
+        benchmark::DoNotOptimize(sum);
+    }
+
+    state.counters["bp/s"] = benchmark::Counter(sequence_length, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+// the same rolling hash as hash_fixed_k with the k-mer size as runtime value, i.e. without seqan3's views
+static void hash_rolling_runtime_k(benchmark::State & state)
+{
+    auto const sequence = random_sequence(sequence_length);
+    std::vector<uint8_t> const kmer_sizes{static_cast<uint8_t>(state.range(0))};
+
+    for (auto _ : state)
+    {
+        uint64_t sum{0};
+        for_each_multi_kmer_hash(sequence, kmer_sizes, [&] (size_t, uint64_t const hash) { sum += hash; });
+        benchmark::DoNotOptimize(sum);
+    }
+
+    state.counters["bp/s"] = benchmark::Counter(sequence_length, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+BENCHMARK(sketch_generic_k)->Arg(15)->Arg(21)->Arg(31);
+BENCHMARK(sketch_fixed_k)->Arg(15)->Arg(21)->Arg(31);
+BENCHMARK(hash_generic_k)->Arg(15)->Arg(21)->Arg(31);
+BENCHMARK(hash_fixed_k)->Arg(15)->Arg(21)->Arg(31);
+BENCHMARK(hash_rolling_runtime_k)->Arg(15)->Arg(21)->Arg(31);
+
+BENCHMARK_MAIN();
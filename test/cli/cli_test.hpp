@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 
 #include <cstdlib>               // system calls
+#include <fstream>               // test files
 #include <seqan3/std/filesystem> // test directory creation
 #include <sstream>               // ostringstream
 #include <string>                // strings
@@ -54,6 +55,21 @@ protected:
         return std::filesystem::path{std::string{DATADIR}}.concat(filename);
     }
 
+    // Write a test file into the work directory.
+    static void write_file(std::string const & filename, std::string const & content)
+    {
+        std::ofstream{filename} << content;
+    }
+
+    // The content of a file in the work directory, e.g. of an output.
+    static std::string read_file(std::string const & filename)
+    {
+        std::ifstream fin{filename};
+        std::stringstream buffer{};
+        buffer << fin.rdbuf();
+        return buffer.str();
+    }
+
     // Create an individual work directory for the current test.
     void SetUp() override
     {
@@ -0,0 +1,83 @@
+#include <sstream>
+#include <string>
+
+#include "cli_test.hpp"
+
+// `smash index` followed by a search of the references in the index, with and without --scaled.
+struct index_search : public cli_test
+{
+    // a pseudo random genome, the same for the same seed
+    static std::string random_genome(uint64_t seed, size_t const length)
+    {
+        std::string genome{};
+        for (size_t i = 0; i < length; ++i)
+        {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            genome += "ACGT"[seed >> 62];
+        }
+        return genome;
+    }
+
+    void SetUp() override
+    {
+        cli_test::SetUp();
+        std::filesystem::create_directories("genomes");
+        write_file("genomes/a.fa", ">a\n" + random_genome(1, 20000) + '\n');
+        write_file("genomes/b.fa", ">b\n" + random_genome(2, 20000) + '\n');
+        write_file("references.txt", "genomes/a.fa\ngenomes/b.fa\n");
+        write_file("queries.txt", "genomes/a.fa\n");
+    }
+
+    // the distances of the only query in the search output
+    static void check_output(std::string const & output)
+    {
+        std::istringstream lines{output};
+        std::string header{};
+        std::string row{};
+        ASSERT_TRUE(std::getline(lines, header));
+        ASSERT_TRUE(std::getline(lines, row));
+
+        // the header names the references, not the files the index was built from
+        EXPECT_EQ(header, "#filenames\tgenomes/a.fa;\tgenomes/b.fa;");
+
+        std::istringstream fields{row};
+        std::string query{};
+        double to_a{};
+        double to_b{};
+        fields >> query >> to_a >> to_b;
+        EXPECT_EQ(query, "genomes/a.fa");
+        EXPECT_GT(to_a, 0.8);
+        EXPECT_LE(to_a, 1.0); // a Jaccard index, an overestimated query size would let it exceed 1
+        EXPECT_LT(to_b, 0.2);
+    }
+};
+
+TEST_F(index_search, all_hashes)
+{
+    cli_test_result index = execute_app("smash", "index", "-i references.txt", "-o index.hibf", "-k 19");
+    ASSERT_EQ(index.exit_code, 0) << index.err;
+    EXPECT_TRUE(std::filesystem::exists("index.hibf.smash"));
+
+    cli_test_result search = execute_app("smash", "-i queries.txt", "-x index.hibf", "-o out.tsv", "-k 19",
+                                         "-s 500", "--fpr 0.05");
+    ASSERT_EQ(search.exit_code, 0) << search.err;
+    check_output(read_file("out.tsv"));
+}
+
+TEST_F(index_search, scaled)
+{
+    cli_test_result index = execute_app("smash", "index", "-i references.txt", "-o index.hibf", "-k 19",
+                                        "--scaled 10");
+    ASSERT_EQ(index.exit_code, 0) << index.err;
+    EXPECT_TRUE(std::filesystem::exists("index.hibf_hashes"));
+
+    cli_test_result search = execute_app("smash", "-i queries.txt", "-x index.hibf", "-o out.tsv", "-k 19",
+                                         "--scaled 10", "--fpr 0.05");
+    ASSERT_EQ(search.exit_code, 0) << search.err;
+    check_output(read_file("out.tsv"));
+
+    // the index only holds the hashes of --scaled 10 sketches
+    cli_test_result smaller_scale = execute_app("smash", "-i queries.txt", "-x index.hibf", "-o out2.tsv",
+                                                "-k 19", "--scaled 5", "--fpr 0.05");
+    EXPECT_NE(smaller_scale.exit_code, 0);
+}
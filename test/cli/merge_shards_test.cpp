@@ -0,0 +1,64 @@
+#include <string>
+
+#include "cli_test.hpp"
+
+struct merge_shards : public cli_test
+{
+    void SetUp() override
+    {
+        cli_test::SetUp();
+        write_file("shard0.tsv", "#filenames\ta;\tb;\nq1\t0.1\t0.2\nq3\t0.5\t0.6\n");
+        write_file("shard1.tsv", "#filenames\ta;\tb;\nq2\t0.3\t0.4\n");
+    }
+};
+
+TEST_F(merge_shards, input_order)
+{
+    write_file("input.txt", "q1\nq2\nq3\n");
+
+    cli_test_result result = execute_app("merge_shards", "--shard shard0.tsv", "--shard shard1.tsv",
+                                         "--input input.txt", "--output merged.tsv");
+    EXPECT_EQ(result.exit_code, 0);
+    EXPECT_EQ(read_file("merged.tsv"), "#filenames\ta;\tb;\nq1\t0.1\t0.2\nq2\t0.3\t0.4\nq3\t0.5\t0.6\n");
+}
+
+TEST_F(merge_shards, concatenate)
+{
+    cli_test_result result = execute_app("merge_shards", "--shard shard1.tsv", "--shard shard0.tsv",
+                                         "--output merged.tsv");
+    EXPECT_EQ(result.exit_code, 0);
+    EXPECT_EQ(read_file("merged.tsv"), "#filenames\ta;\tb;\nq2\t0.3\t0.4\nq1\t0.1\t0.2\nq3\t0.5\t0.6\n");
+}
+
+TEST_F(merge_shards, missing_query_writes_no_output)
+{
+    write_file("input.txt", "q1\nq2\nq3\nq4\n");
+
+    cli_test_result result = execute_app("merge_shards", "--shard shard0.tsv", "--shard shard1.tsv",
+                                         "--input input.txt", "--output merged.tsv");
+    EXPECT_NE(result.exit_code, 0);
+    EXPECT_NE(result.err.find("in no shard, e.g. q4"), std::string::npos);
+    EXPECT_FALSE(std::filesystem::exists("merged.tsv"));
+    EXPECT_FALSE(std::filesystem::exists("merged.tsv.tmp"));
+}
+
+TEST_F(merge_shards, query_in_two_shards)
+{
+    write_file("input.txt", "q1\nq2\nq3\n");
+    write_file("shard2.tsv", "#filenames\ta;\tb;\nq2\t0.3\t0.4\n");
+
+    cli_test_result result = execute_app("merge_shards", "--shard shard0.tsv", "--shard shard1.tsv",
+                                         "--shard shard2.tsv", "--input input.txt", "--output merged.tsv");
+    EXPECT_NE(result.exit_code, 0);
+    EXPECT_FALSE(std::filesystem::exists("merged.tsv"));
+}
+
+TEST_F(merge_shards, different_headers)
+{
+    write_file("shard2.tsv", "#filenames\tc;\nq4\t0.7\n");
+
+    cli_test_result result = execute_app("merge_shards", "--shard shard0.tsv", "--shard shard2.tsv",
+                                         "--output merged.tsv");
+    EXPECT_NE(result.exit_code, 0);
+    EXPECT_FALSE(std::filesystem::exists("merged.tsv"));
+}
@@ -0,0 +1,34 @@
+#include <string>
+
+#include "cli_test.hpp"
+
+// --kmer-sizes searches with sketches only, the options of the other modes are rejected instead of ignored.
+struct multi_k_search : public cli_test
+{
+    void SetUp() override
+    {
+        cli_test::SetUp();
+        write_file("queries.txt", "a.fa\n");
+        write_file("a.fa", ">a\nACGTTGCAACGTAGCTAGCTAGGCTAGCATCGATCGACTAGC\n");
+    }
+};
+
+TEST_F(multi_k_search, rejects_other_modes)
+{
+    for (std::string const mode : {"--disable-sketching", "--hll", "--references queries.txt", "--update old.tsv"})
+    {
+        cli_test_result result = execute_app("smash", "-i queries.txt", "-o out.tsv", "--kmer-sizes 15",
+                                             "--indexes k15.hibf", mode);
+        EXPECT_NE(result.exit_code, 0) << mode;
+        EXPECT_NE(result.err.find("--kmer-sizes"), std::string::npos) << mode << ": " << result.err;
+    }
+}
+
+TEST_F(multi_k_search, rejects_duplicate_kmer_sizes)
+{
+    cli_test_result result = execute_app("smash", "-i queries.txt", "-o out.tsv", "--kmer-sizes 21",
+                                         "--kmer-sizes 21", "--indexes k21.hibf", "--indexes k21.hibf");
+    EXPECT_NE(result.exit_code, 0);
+    EXPECT_NE(result.err.find("given twice"), std::string::npos) << result.err;
+    EXPECT_FALSE(std::filesystem::exists("out.tsv.k21"));
+}
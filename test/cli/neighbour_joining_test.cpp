@@ -0,0 +1,47 @@
+#include <string>
+
+#include "cli_test.hpp"
+
+struct neighbour_joining : public cli_test {};
+
+// The additive tree of the five taxa example of Saitou and Nei, with all distances divided by 20 such that they are
+// 1 - J of Jaccard indices: ((a:2, b:3):3, c:4):2 joined with d:2 and e:1.
+TEST_F(neighbour_joining, known_tree)
+{
+    write_file("matrix.tsv", "#filenames\ta;\tb;\tc;\td;\te;\n"
+                             "a\t1\t0.75\t0.55\t0.55\t0.6\n"
+                             "b\t0.75\t1\t0.5\t0.5\t0.55\n"
+                             "c\t0.55\t0.5\t1\t0.6\t0.65\n"
+                             "d\t0.55\t0.5\t0.6\t1\t0.85\n"
+                             "e\t0.6\t0.55\t0.65\t0.85\t1\n");
+
+    cli_test_result result = execute_app("neighbour_joining", "--input matrix.tsv", "--output tree.nwk");
+    EXPECT_EQ(result.exit_code, 0);
+    EXPECT_EQ(read_file("tree.nwk"),
+              "(((a:0.100000,b:0.150000):0.150000,c:0.200000):0.100000,d:0.100000,e:0.050000);\n");
+}
+
+// rows in another order than the columns, a column without a row and a row without a column
+TEST_F(neighbour_joining, rows_and_columns_differ)
+{
+    write_file("matrix.tsv", "#filenames\ta;\tb;\tx;\tc;\td;\te;\n"
+                             "e\t0.6\t0.55\t0.1\t0.65\t0.85\t1\n"
+                             "b\t0.75\t1\t0.1\t0.5\t0.5\t0.55\n"
+                             "y\t0.1\t0.1\t0.1\t0.1\t0.1\t0.1\n"
+                             "a\t1\t0.75\t0.1\t0.55\t0.55\t0.6\n"
+                             "d\t0.55\t0.5\t0.1\t0.6\t1\t0.85\n"
+                             "c\t0.55\t0.5\t0.1\t1\t0.6\t0.65\n");
+
+    cli_test_result result = execute_app("neighbour_joining", "--input matrix.tsv", "--output tree.nwk");
+    EXPECT_EQ(result.exit_code, 0);
+    EXPECT_EQ(read_file("tree.nwk"),
+              "(((a:0.100000,b:0.150000):0.150000,c:0.200000):0.100000,d:0.100000,e:0.050000);\n");
+}
+
+TEST_F(neighbour_joining, no_taxa)
+{
+    write_file("matrix.tsv", "#filenames\ta;\tb;\nq\t0.5\t0.5\n");
+
+    cli_test_result result = execute_app("neighbour_joining", "--input matrix.tsv", "--output tree.nwk");
+    EXPECT_NE(result.exit_code, 0);
+}
@@ -0,0 +1,38 @@
+#include <string>
+
+#include "cli_test.hpp"
+
+struct write_sketches : public cli_test
+{
+    void SetUp() override
+    {
+        cli_test::SetUp();
+        std::filesystem::create_directories("a");
+        std::filesystem::create_directories("b");
+        write_file("a/x.fa", ">x\nACGGTCAAGTTCGATCGGATCCATGCAAGTCGTTAGCATCGGAC\n");
+        write_file("b/x.fa", ">x\nTTGACCGATGCAAGTCGTTAGCATCGGAACGGTCAAGTTCGATC\n");
+        write_file("b/y.fa", ">y\nGGATCCATGCAAGTCGTTAGCATCGGACTTGACCGATGCAAGTC\n");
+    }
+};
+
+TEST_F(write_sketches, one_sketch_per_file)
+{
+    write_file("input.txt", "a/x.fa\nb/y.fa\n");
+
+    cli_test_result result = execute_app("write_sketches", "--input input.txt", "--output sketches",
+                                         "--kmer-size 15", "--sketch-size 10");
+    EXPECT_EQ(result.exit_code, 0);
+    EXPECT_TRUE(std::filesystem::exists("sketches/x.fa.sketch"));
+    EXPECT_TRUE(std::filesystem::exists("sketches/y.fa.sketch"));
+}
+
+TEST_F(write_sketches, same_file_name)
+{
+    write_file("input.txt", "a/x.fa\nb/x.fa\n");
+
+    cli_test_result result = execute_app("write_sketches", "--input input.txt", "--output sketches",
+                                         "--kmer-size 15", "--sketch-size 10");
+    EXPECT_NE(result.exit_code, 0);
+    EXPECT_NE(result.err.find("The sketches of a/x.fa and b/x.fa would both be written to"), std::string::npos);
+    EXPECT_FALSE(std::filesystem::exists("sketches"));
+}